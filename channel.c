@@ -3,18 +3,40 @@ An example implementation of channel-related utilities.
 Might be changed during testing,
 but as stated in the assignment description the provided functions' behaviour
 shouldn't observably differ in any way other than execution duration.
+
+Execution duration follows a simple network model, configured with environment variables:
+- MIMPI_WRITE_DELAY and MIMPI_READ_DELAY - milliseconds per ATOMIC_BLOCK_SIZE bytes
+  sent or asked for, the former overridden by CHANNELS_WRITE_DELAY, which is looked up on every send
+  so that a program can delay only a part of its communication,
+- MIMPI_LATENCY_US - microseconds it takes data to reach the other end,
+- MIMPI_BANDWIDTH - bytes per second a channel carries, unlimited if 0,
+- MIMPI_JITTER_US - at most that many microseconds added to the latency of a send at random,
+- MIMPI_NET_SEED - seed of the random jitter, so that runs can be repeated,
+- MIMPI_NET_CONFIG - file overriding the above for the channels between given processes (see channel_ends),
+  with lines like `<from> <to> latency_us=<n> bandwidth=<n> jitter_us=<n>` ('*' matches any rank).
+Every descriptor is a link of its own: sends on it wait for one another, like data on a wire,
+but never for sends and reads on other descriptors.
 */
 #include "channel.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#define WRITE_VAR "MIMPI_WRITE_DELAY"
+#define WRITE_VAR_RUNTIME "CHANNELS_WRITE_DELAY"
+#define READ_VAR "MIMPI_READ_DELAY"
+#define ATOMIC_BLOCK_SIZE 512
+#define MAX_FDS 1024
+#define MAX_CONFIG_LINE 256
+
 /* Assert that expression evaluates to zero (otherwise use result as error number, as in pthreads). */
 #define ASSERT_ZERO(expr)                                                                    \
     do {                                                                                     \
@@ -23,55 +45,175 @@ shouldn't observably differ in any way other than execution duration.
             fprintf(                                                                         \
                 stderr,                                                                      \
                 "ERROR: Failed: %s\n\tIn function %s() in %s line %d.\n\tErrno: (%d; %s)\n", \
-                #expr, __func__, __FILE__, __LINE__, errno, strerror(errno)                  \
+                #expr, __func__, __FILE__, __LINE__, _errno, strerror(_errno)                \
             );                                                                               \
     } while(0)
 
-// based on: https://stackoverflow.com/questions/1157209/is-there-an-alternative-sleep-function-in-c-to-milliseconds
-/* msleep(): Sleep for the requested number of milliseconds. */
-static int msleep(long msec)
+typedef struct link_params
+{
+    long latency_us;
+    long long bandwidth; // Bytes per second, 0 for no limit.
+    long jitter_us;
+
+} link_params_t;
+
+typedef struct link
+{
+    bool configured; // Whether params have been set up for the descriptor.
+    int from; // Processes at the ends, as told by channel_ends, or -1.
+    int to;
+    link_params_t params;
+    long long busy_until_ns; // When the data so far has been put on the link.
+    long long arrival_ns; // When the data so far has reached the other end.
+    unsigned int rng;
+
+} link_t;
+
+static long g_write_delay_ms;
+static long g_read_delay_ms;
+static link_params_t g_default_params;
+static unsigned int g_seed;
+static const char* g_config_path;
+static pthread_mutex_t g_links_mutex; // Held only to book time on a link, never while sleeping.
+static link_t g_links[MAX_FDS];
+
+static long env_long(const char* name, long default_value)
+{
+    const char* str = getenv(name);
+    return str ? atol(str) : default_value;
+}
+
+static long long now_ns()
 {
     struct timespec ts;
-    int res;
+    ASSERT_ZERO(clock_gettime(CLOCK_MONOTONIC, &ts));
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-    if (msec < 0)
-    {
-        errno = EINVAL;
-        return -1;
-    }
+static void sleep_until(long long wake_ns)
+{
+    struct timespec ts;
+    int res;
 
-    ts.tv_sec = msec / 1000;
-    ts.tv_nsec = (msec % 1000) * 1000000;
+    ts.tv_sec = wake_ns / 1000000000LL;
+    ts.tv_nsec = wake_ns % 1000000000LL;
 
     do
     {
-        res = nanosleep(&ts, &ts);
-    } while (res && errno == EINTR);
+        res = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    } while (res == EINTR);
 
-    return res;
+    ASSERT_ZERO(res);
 }
 
-#define WRITE_VAR "MIMPI_WRITE_DELAY"
-#define READ_VAR "MIMPI_READ_DELAY"
-#define ATOMIC_BLOCK_SIZE 512
-
-pthread_mutex_t g_mutex;
+static bool rank_matches(const char* pattern, int rank)
+{
+    return strcmp(pattern, "*") == 0 || atoi(pattern) == rank;
+}
 
-static void delay(const char *delay_var, const size_t size)
+// Applies the lines of the config file concerning the channel from one process to another.
+// Later lines win.
+static void read_config(link_params_t* params, int from, int to)
 {
-    ASSERT_ZERO(pthread_mutex_lock(&g_mutex));
+    FILE* file = fopen(g_config_path, "r");
+    char line[MAX_CONFIG_LINE];
+
+    if (!file)
+    {
+        perror(g_config_path);
+        exit(1);
+    }
 
-    const char *delay_str = getenv(delay_var);
-    if (delay_str)
+    while (fgets(line, sizeof(line), file))
     {
-        int delay_ms = atoi(delay_str);
-        if (delay_ms > 0)
+        char from_str[16];
+        char to_str[16];
+        int consumed;
+
+        if (line[0] == '#' || sscanf(line, "%15s %15s%n", from_str, to_str, &consumed) != 2)
+            continue;
+        if (!rank_matches(from_str, from) || !rank_matches(to_str, to))
+            continue;
+
+        char* saveptr;
+        for (char* item = strtok_r(line + consumed, " \t\n", &saveptr); item;
+             item = strtok_r(NULL, " \t\n", &saveptr))
         {
-            msleep(delay_ms * (size + ATOMIC_BLOCK_SIZE - 1) / ATOMIC_BLOCK_SIZE);
+            if (sscanf(item, "latency_us=%ld", &params->latency_us) == 1)
+                continue;
+            if (sscanf(item, "bandwidth=%lld", &params->bandwidth) == 1)
+                continue;
+            if (sscanf(item, "jitter_us=%ld", &params->jitter_us) == 1)
+                continue;
+            fprintf(stderr, "Unknown setting in %s: %s\n", g_config_path, item);
+            exit(1);
         }
     }
-    // Defaults to not wait
-    ASSERT_ZERO(pthread_mutex_unlock(&g_mutex));
+    fclose(file);
+}
+
+// Never to be performed outside g_links_mutex!!!
+static link_t* get_link(int fd)
+{
+    link_t* link = &g_links[fd];
+
+    if (link->configured)
+        return link;
+
+    link->configured = true;
+    link->params = g_default_params;
+    link->busy_until_ns = 0;
+    link->arrival_ns = 0;
+    link->rng = g_seed ^ (fd * 2654435761u);
+
+    if (g_config_path && link->from >= 0)
+        read_config(&link->params, link->from, link->to);
+
+    return link;
+}
+
+// Books the time the data needs on the link and returns when it reaches the other end.
+// The caller sleeps until then, unlike a real sender, which is free once the data is on the link.
+// So time it has spent since the previous data arrived counts from when it would have been free,
+// and data sent in a row arrives one transfer after another instead of paying the latency each time.
+static long long book(int fd, long block_delay_ms, size_t size, bool sending)
+{
+    long long now = now_ns();
+    long long transfer_ns = block_delay_ms * 1000000LL * ((size + ATOMIC_BLOCK_SIZE - 1) / ATOMIC_BLOCK_SIZE);
+    long long latency_ns = 0;
+
+    if (fd < 0 || fd >= MAX_FDS)
+        return now + transfer_ns;
+
+    ASSERT_ZERO(pthread_mutex_lock(&g_links_mutex));
+    link_t* link = get_link(fd);
+
+    if (sending)
+    {
+        if (link->params.bandwidth > 0)
+            transfer_ns += size * 1000000000LL / link->params.bandwidth;
+        latency_ns = link->params.latency_us * 1000LL;
+        if (link->params.jitter_us > 0)
+            latency_ns += rand_r(&link->rng) % (link->params.jitter_us + 1) * 1000LL;
+    }
+
+    long long idle = (now > link->arrival_ns) ? now - link->arrival_ns : 0;
+    long long start = link->busy_until_ns + idle;
+    long long arrival = start + transfer_ns + latency_ns;
+
+    link->busy_until_ns = start + transfer_ns;
+    if (arrival > link->arrival_ns) // Data never overtakes the data sent before.
+        link->arrival_ns = arrival;
+    arrival = link->arrival_ns;
+    ASSERT_ZERO(pthread_mutex_unlock(&g_links_mutex));
+
+    return arrival;
+}
+
+static bool emulating(long write_delay_ms)
+{
+    return write_delay_ms > 0 || g_default_params.latency_us > 0 || g_default_params.bandwidth > 0 ||
+           g_default_params.jitter_us > 0 || g_config_path;
 }
 
 int channel(int pipefd[2])
@@ -79,28 +221,65 @@ int channel(int pipefd[2])
     return pipe(pipefd);
 }
 
+void channel_ends(int __fd, int __from, int __to)
+{
+    if (__fd < 0 || __fd >= MAX_FDS)
+        return;
+
+    ASSERT_ZERO(pthread_mutex_lock(&g_links_mutex));
+    g_links[__fd].configured = false; // So that the settings of the pair get read.
+    g_links[__fd].from = __from;
+    g_links[__fd].to = __to;
+    ASSERT_ZERO(pthread_mutex_unlock(&g_links_mutex));
+}
+
 void channels_init() {
     signal(SIGPIPE, SIG_IGN);
 
-    pthread_mutexattr_t attr;
-    ASSERT_ZERO(pthread_mutexattr_init(&attr));
-    ASSERT_ZERO(pthread_mutex_init(&g_mutex, &attr));
-    ASSERT_ZERO(pthread_mutexattr_destroy(&attr));
+    g_write_delay_ms = env_long(WRITE_VAR, 0);
+    g_read_delay_ms = env_long(READ_VAR, 0);
+    g_default_params.latency_us = env_long("MIMPI_LATENCY_US", 0);
+    g_default_params.bandwidth = env_long("MIMPI_BANDWIDTH", 0);
+    g_default_params.jitter_us = env_long("MIMPI_JITTER_US", 0);
+    g_seed = env_long("MIMPI_NET_SEED", 0);
+    g_config_path = getenv("MIMPI_NET_CONFIG");
+
+    ASSERT_ZERO(pthread_mutex_init(&g_links_mutex, NULL));
+    for (int fd = 0; fd < MAX_FDS; fd++)
+    {
+        g_links[fd].configured = false;
+        g_links[fd].from = -1;
+        g_links[fd].to = -1;
+    }
 }
 
 void channels_finalize() {
-    ASSERT_ZERO(pthread_mutex_destroy(&g_mutex));
+    ASSERT_ZERO(pthread_mutex_destroy(&g_links_mutex));
+}
+
+long long chbook(int __fd, size_t __n)
+{
+    long write_delay_ms = env_long(WRITE_VAR_RUNTIME, g_write_delay_ms);
+
+    return emulating(write_delay_ms) ? book(__fd, write_delay_ms, __n, true) : 0;
+}
+
+void chwait(long long __until)
+{
+    if (__until > 0)
+        sleep_until(__until);
 }
 
 int chsend(int __fd, const void *__buf, size_t __n)
 {
-    delay(WRITE_VAR, __n);
+    chwait(chbook(__fd, __n));
     return write(__fd, __buf, __n);
 }
 
 int chrecv(int __fd, void *__buf, size_t __nbytes)
 {
     ssize_t res = read(__fd, __buf, __nbytes);
-    delay(READ_VAR, __nbytes);
+    if (g_read_delay_ms > 0)
+        sleep_until(book(__fd, g_read_delay_ms, __nbytes, false));
     return res;
 }
@@ -25,10 +25,26 @@ Works similarly to `pipe`, but possibly takes more time to finish.
 */
 int channel(int pipefd[2]);
 /*
+Tells that data sent on the descriptor goes from process `__from` to process `__to`,
+so that the settings given for that pair of processes apply to it.
+Optional, and to be called before the first `chsend` on the descriptor.
+*/
+void channel_ends(int __fd, int __from, int __to);
+/*
 Works similarly to `write`, but possibly takes more time to finish.
 */
 int chsend(int __fd, const void *__buf, size_t __n);
 /*
+Books the time `chsend` of `__n` bytes on the descriptor would take, but writes nothing,
+for data written some other way, like through io_uring. Returns when the data would reach
+the other end, to be passed to `chwait` before writing it.
+*/
+long long chbook(int __fd, size_t __n);
+/*
+Waits until the time returned by `chbook`.
+*/
+void chwait(long long __until);
+/*
 Works similarly to `read`, but possibly takes more time to finish.
 */
 int chrecv(int __fd, void *__buf, size_t __nbytes);
@@ -0,0 +1,47 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+int main(int argc, char **argv)
+{
+    int block_size = 3;
+    if (argc > 1)
+    {
+        block_size = atoi(argv[1]);
+    }
+
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    uint8_t *send_data = malloc(block_size * world_size);
+    uint8_t *recv_data = malloc(block_size * world_size);
+    assert(send_data && recv_data);
+
+    for (int i = 0; i < block_size; ++i)
+        send_data[i] = world_rank * 7 + i;
+    ASSERT_MIMPI_OK(MIMPI_Allgather(send_data, recv_data, block_size, MIMPI_COMM_WORLD));
+    for (int j = 0; j < world_size; ++j)
+        for (int i = 0; i < block_size; ++i)
+            assert(recv_data[j * block_size + i] == (uint8_t) (j * 7 + i));
+
+    // Block sent from rank i to rank j holds i * 16 + j.
+    for (int j = 0; j < world_size; ++j)
+        for (int i = 0; i < block_size; ++i)
+            send_data[j * block_size + i] = world_rank * 16 + j + i;
+    ASSERT_MIMPI_OK(MIMPI_Alltoall(send_data, recv_data, block_size, MIMPI_COMM_WORLD));
+    for (int j = 0; j < world_size; ++j)
+        for (int i = 0; i < block_size; ++i)
+            assert(recv_data[j * block_size + i] == (uint8_t) (j * 16 + world_rank + i));
+
+    free(send_data);
+    free(recv_data);
+
+    MIMPI_Finalize();
+    return 0;
+}
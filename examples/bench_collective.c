@@ -0,0 +1,106 @@
+/*
+Times a single collective for the scaling harness (see the `scaling` script).
+Usage: bench_collective <collective> [count]
+Only the collective itself is delayed by DELAY, like in the effectiveness tests.
+Process 0 prints the time from the earliest start to the latest end over all processes.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define WRITE_VAR "CHANNELS_WRITE_DELAY"
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static MIMPI_Retcode run(const char *name, uint8_t *send, uint8_t *recv, int count)
+{
+    if (strcmp(name, "barrier") == 0)
+        return MIMPI_Barrier();
+    if (strcmp(name, "bcast") == 0)
+        return MIMPI_Bcast(send, count, 0);
+    if (strcmp(name, "reduce") == 0)
+        return MIMPI_Reduce(send, recv, count, MIMPI_SUM, 0);
+    if (strcmp(name, "allgather") == 0)
+        return MIMPI_Allgather(send, recv, count, MIMPI_COMM_WORLD);
+    if (strcmp(name, "alltoall") == 0)
+        return MIMPI_Alltoall(send, recv, count, MIMPI_COMM_WORLD);
+    if (strcmp(name, "gather") == 0)
+        return MIMPI_Gather(send, recv, count, 0, MIMPI_COMM_WORLD);
+    if (strcmp(name, "scatter") == 0)
+        return MIMPI_Scatter(send, recv, count, 0, MIMPI_COMM_WORLD);
+    if (strcmp(name, "scan") == 0)
+        return MIMPI_Scan(send, recv, count, MIMPI_SUM, MIMPI_COMM_WORLD);
+    fprintf(stderr, "Unknown collective: %s\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    assert(argc > 1);
+    const char *name = argv[1];
+    int count = (argc > 2) ? atoi(argv[2]) : 1;
+
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    uint8_t *send = malloc((size_t) count * world_size);
+    uint8_t *recv = malloc((size_t) count * world_size);
+    assert(send && recv);
+    memset(send, 1, (size_t) count * world_size);
+
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+
+    const char *delay = getenv("DELAY");
+    if (delay)
+    {
+        int res = setenv(WRITE_VAR, delay, true);
+        assert(res == 0);
+    }
+
+    long long times[2];
+    times[0] = now_ns();
+    ASSERT_MIMPI_OK(run(name, send, recv, count));
+    times[1] = now_ns();
+
+    int res = unsetenv(WRITE_VAR);
+    assert(res == 0);
+
+    long long *all = malloc(sizeof(times) * world_size);
+    assert(all);
+    ASSERT_MIMPI_OK(MIMPI_Gather(times, all, sizeof(times), 0, MIMPI_COMM_WORLD));
+
+    if (world_rank == 0)
+    {
+        long long start = all[0];
+        long long end = all[1];
+        for (int i = 1; i < world_size; ++i)
+        {
+            if (all[2 * i] < start)
+                start = all[2 * i];
+            if (all[2 * i + 1] > end)
+                end = all[2 * i + 1];
+        }
+        printf("elapsed_us %lld\n", (end - start) / 1000);
+    }
+
+    free(all);
+    free(send);
+    free(recv);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define ROW_LEN 2
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const row = world_rank / ROW_LEN;
+
+    // Ranks in a row are numbered in reverse.
+    MIMPI_Comm row_comm;
+    ASSERT_MIMPI_OK(MIMPI_Comm_split(MIMPI_COMM_WORLD, row, -world_rank, &row_comm));
+    int const row_rank = MIMPI_Comm_rank(row_comm);
+    int const row_size = MIMPI_Comm_size(row_comm);
+    assert(row_size == ((row + 1) * ROW_LEN <= world_size ? ROW_LEN : world_size % ROW_LEN));
+    assert(row_rank == row_size - 1 - world_rank % ROW_LEN);
+
+    uint8_t send_data = world_rank;
+    uint8_t recv_data = 0;
+    ASSERT_MIMPI_OK(MIMPI_Comm_reduce(&send_data, &recv_data, 1, MIMPI_MAX, 0, row_comm));
+    if (row_rank == 0)
+        assert(recv_data == row * ROW_LEN + row_size - 1);
+
+    ASSERT_MIMPI_OK(MIMPI_Comm_bcast(&recv_data, 1, 0, row_comm));
+    assert(recv_data == row * ROW_LEN + row_size - 1);
+
+    // Messages of a duplicate never match receives in the original communicator.
+    MIMPI_Comm dup_comm;
+    ASSERT_MIMPI_OK(MIMPI_Comm_dup(MIMPI_COMM_WORLD, &dup_comm));
+    assert(MIMPI_Comm_rank(dup_comm) == world_rank);
+    if (world_rank == 0) {
+        int number = 1;
+        ASSERT_MIMPI_OK(MIMPI_Comm_send(&number, sizeof(int), 1, 7, dup_comm));
+        number = 2;
+        ASSERT_MIMPI_OK(MIMPI_Send(&number, sizeof(int), 1, 7));
+    } else if (world_rank == 1) {
+        int number;
+        ASSERT_MIMPI_OK(MIMPI_Recv(&number, sizeof(int), 0, 7));
+        assert(number == 2);
+        ASSERT_MIMPI_OK(MIMPI_Comm_recv(&number, sizeof(int), 0, 7, dup_comm));
+        assert(number == 1);
+    }
+
+    MIMPI_Comm none;
+    ASSERT_MIMPI_OK(MIMPI_Comm_split(dup_comm, world_rank == 0 ? MIMPI_UNDEFINED : 0, 0, &none));
+    assert((world_rank == 0) == (none == MIMPI_COMM_NULL));
+    if (none != MIMPI_COMM_NULL) {
+        assert(MIMPI_Comm_rank(none) == world_rank - 1);
+        ASSERT_MIMPI_OK(MIMPI_Comm_barrier(none));
+        ASSERT_MIMPI_OK(MIMPI_Comm_free(&none));
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Comm_barrier(dup_comm));
+    ASSERT_MIMPI_OK(MIMPI_Comm_free(&dup_comm));
+    ASSERT_MIMPI_OK(MIMPI_Comm_free(&row_comm));
+    assert(MIMPI_Comm_barrier(row_comm) == MIMPI_ERROR_INVALID_COMM);
+
+    MIMPI_Finalize();
+    return 0;
+}
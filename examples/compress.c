@@ -0,0 +1,78 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define SPARSE_LEN (1 << 20)
+#define TEXT_LEN (256 * 1024)
+#define RANDOM_LEN (64 * 1024)
+
+static void fill(uint8_t *sparse, char *text, uint8_t *random)
+{
+    memset(sparse, 0, SPARSE_LEN);
+    for (int i = 0; i < SPARSE_LEN; i += 997)
+        sparse[i] = i % 251 + 1;
+
+    int len = 0;
+    for (int i = 0; len + 64 < TEXT_LEN; ++i)
+        len += sprintf(text + len, "record %d: name=worker-%d status=ok\n", i, i % 13);
+    memset(text + len, 0, TEXT_LEN - len);
+
+    uint32_t x = 12345;
+    for (int i = 0; i < RANDOM_LEN; ++i)
+    {
+        x = x * 1103515245 + 12345;
+        random[i] = x >> 16;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+
+    uint8_t *sparse = malloc(SPARSE_LEN);
+    char *text = malloc(TEXT_LEN);
+    uint8_t *random = malloc(RANDOM_LEN);
+    uint8_t *buf = malloc(SPARSE_LEN);
+    assert(sparse && text && random && buf);
+    fill(sparse, text, random);
+
+    if (world_rank == 0)
+    {
+        ASSERT_MIMPI_OK(MIMPI_Send(sparse, SPARSE_LEN, 1, 1));
+        ASSERT_MIMPI_OK(MIMPI_Send(text, TEXT_LEN, 1, 2));
+        ASSERT_MIMPI_OK(MIMPI_Send(random, RANDOM_LEN, 1, 3));
+        ASSERT_MIMPI_OK(MIMPI_Send(text, 100, 1, 4));
+        printf("ratio %.1f\n", MIMPI_Compression_ratio());
+    }
+    else if (world_rank == 1)
+    {
+        ASSERT_MIMPI_OK(MIMPI_Recv(buf, SPARSE_LEN, 0, 1));
+        assert(memcmp(buf, sparse, SPARSE_LEN) == 0);
+        ASSERT_MIMPI_OK(MIMPI_Recv(buf, TEXT_LEN, 0, 2));
+        assert(memcmp(buf, text, TEXT_LEN) == 0);
+        ASSERT_MIMPI_OK(MIMPI_Recv(buf, RANDOM_LEN, 0, 3));
+        assert(memcmp(buf, random, RANDOM_LEN) == 0);
+        ASSERT_MIMPI_OK(MIMPI_Recv(buf, 100, 0, 4));
+        assert(memcmp(buf, text, 100) == 0);
+    }
+
+    // Collectives go through the same framing.
+    memcpy(buf, sparse, SPARSE_LEN);
+    ASSERT_MIMPI_OK(MIMPI_Bcast(buf, SPARSE_LEN, 0));
+    assert(memcmp(buf, sparse, SPARSE_LEN) == 0);
+
+    free(sparse);
+    free(text);
+    free(random);
+    free(buf);
+
+    MIMPI_Finalize();
+    return 0;
+}
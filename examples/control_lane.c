@@ -0,0 +1,72 @@
+/*
+While a thread of process 0 sends a few megabytes to process 1,
+its main thread sends a few bytes, which process 1 receives first.
+They take as long as they take on their own, not as long as the big message,
+only if they do not wait behind the data.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define DATA_LEN (4 << 20)
+#define NOTE_LEN 16
+
+static uint8_t data[DATA_LEN];
+
+static long long now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void *send_data(void *arg)
+{
+    ASSERT_MIMPI_OK(MIMPI_Send(data, DATA_LEN, 1, 1));
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    char note[NOTE_LEN] = "urgent";
+
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+
+    if (world_rank == 0)
+    {
+        pthread_t thread;
+        memset(data, 42, DATA_LEN);
+        assert(pthread_create(&thread, NULL, send_data, NULL) == 0);
+        usleep(50000); // So that the big message is on its way.
+        ASSERT_MIMPI_OK(MIMPI_Send(note, NOTE_LEN, 1, 2));
+        assert(pthread_join(thread, NULL) == 0);
+    }
+    else if (world_rank == 1)
+    {
+        long long start = now_ms();
+        ASSERT_MIMPI_OK(MIMPI_Recv(note, NOTE_LEN, 0, 2));
+        long long note_ms = now_ms() - start;
+        ASSERT_MIMPI_OK(MIMPI_Recv(data, DATA_LEN, 0, 1));
+        long long data_ms = now_ms() - start;
+
+        assert(strcmp(note, "urgent") == 0);
+        for (int i = 0; i < DATA_LEN; ++i)
+            assert(data[i] == 42);
+        printf("note_ms %lld data_ms %lld\n", note_ms, data_ms);
+    }
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,43 @@
+/*
+Every process sends a few kilobytes to process 0 at the same time.
+With delays on reads, receiving them takes as long as receiving one of them
+only if reads from different processes do not wait for each other.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define DATA_LEN 4096
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    char data[DATA_LEN];
+
+    if (world_rank != 0)
+    {
+        memset(data, world_rank, DATA_LEN);
+        ASSERT_MIMPI_OK(MIMPI_Send(data, DATA_LEN, 0, 1));
+    }
+    else
+    {
+        for (int src = 1; src < world_size; ++src)
+        {
+            ASSERT_MIMPI_OK(MIMPI_Recv(data, DATA_LEN, src, 1));
+            for (int i = 0; i < DATA_LEN; ++i)
+                assert(data[i] == src);
+        }
+        printf("Received from %d processes\n", world_size - 1);
+    }
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+// Many more messages than fit in a delivery queue, all sent before anything is received.
+#define NUM_MSGS 4000
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(true);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    for (int i = 0; i < NUM_MSGS; ++i)
+        for (int peer = 0; peer < world_size; ++peer)
+            if (peer != world_rank)
+            {
+                int value = world_rank * NUM_MSGS + i;
+                ASSERT_MIMPI_OK(MIMPI_Send(&value, sizeof(int), peer, 1 + i % 2));
+            }
+
+    // Messages with the same tag come in the order they were sent, regardless of the others.
+    for (int tag = 2; tag >= 1; --tag)
+        for (int peer = 0; peer < world_size; ++peer)
+            if (peer != world_rank)
+                for (int i = tag - 1; i < NUM_MSGS; i += 2)
+                {
+                    int value;
+                    ASSERT_MIMPI_OK(MIMPI_Recv(&value, sizeof(int), peer, tag));
+                    assert(value == peer * NUM_MSGS + i);
+                }
+
+    MIMPI_Barrier();
+    printf("Done %d\n", world_rank);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define BLOCK 5
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    uint8_t send_data[16 * 17 / 2];
+    uint8_t recv_data[16 * 17 / 2];
+
+    for (int root = 0; root < world_size; ++root) {
+        for (int i = 0; i < BLOCK; ++i)
+            send_data[i] = world_rank * BLOCK + i;
+        ASSERT_MIMPI_OK(MIMPI_Gather(send_data, recv_data, BLOCK, root, MIMPI_COMM_WORLD));
+        if (world_rank == root)
+            for (int i = 0; i < BLOCK * world_size; ++i)
+                assert(recv_data[i] == i);
+
+        if (world_rank == root)
+            for (int i = 0; i < BLOCK * world_size; ++i)
+                send_data[i] = 2 * i;
+        ASSERT_MIMPI_OK(MIMPI_Scatter(send_data, recv_data, BLOCK, root, MIMPI_COMM_WORLD));
+        for (int i = 0; i < BLOCK; ++i)
+            assert(recv_data[i] == 2 * (world_rank * BLOCK + i));
+    }
+
+    // Process i has i + 1 bytes, stored in reverse order of ranks.
+    int counts[16];
+    int displs[16];
+    int offset = 0;
+    for (int i = world_size - 1; i >= 0; --i) {
+        counts[i] = i + 1;
+        displs[i] = offset;
+        offset += counts[i];
+    }
+
+    int const root = world_size / 2;
+    for (int i = 0; i <= world_rank; ++i)
+        send_data[i] = world_rank;
+    ASSERT_MIMPI_OK(MIMPI_Gatherv(send_data, world_rank + 1, recv_data, counts, displs, root, MIMPI_COMM_WORLD));
+    if (world_rank == root)
+        for (int i = 0; i < world_size; ++i)
+            for (int j = 0; j < counts[i]; ++j)
+                assert(recv_data[displs[i] + j] == i);
+
+    ASSERT_MIMPI_OK(MIMPI_Scatterv(recv_data, counts, displs, send_data, world_rank + 1, root, MIMPI_COMM_WORLD));
+    for (int i = 0; i <= world_rank; ++i)
+        assert(send_data[i] == world_rank);
+
+    MIMPI_Finalize();
+    return 0;
+}
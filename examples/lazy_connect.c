@@ -0,0 +1,77 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+// Counts entries of a /proc directory with numeric names in [min, max].
+static int count_entries(char const *path, int min, int max)
+{
+    DIR *dir = opendir(path);
+    assert(dir);
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        int num = atoi(entry->d_name);
+        if (num >= min && num <= max)
+            ++count;
+    }
+    closedir(dir);
+    return count;
+}
+
+// Descriptors in the range reserved for the library.
+static int library_fds(void)
+{
+    return count_entries("/proc/self/fd", 20, 1023);
+}
+
+static int threads(void)
+{
+    return count_entries("/proc/self/task", 0, 1 << 30);
+}
+
+// Usage: lazy_connect [stripes], where stripes is the value of mimpirun --stripes.
+int main(int argc, char **argv)
+{
+    // Channels each way between two processes: the data ones and the control one.
+    int const lanes = ((argc > 1) ? atoi(argv[1]) : 1) + 1;
+
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    int const right = (world_rank + 1) % world_size;
+    int const left = (world_rank - 1 + world_size) % world_size;
+    int const partners = (world_size == 1) ? 0 : (right == left) ? 1 : 2;
+
+    // Nothing but the socket to mimpirun and the thread listening on it, except for the channels
+    // partners may have asked for already, as mimpirun passes them to both ends.
+    assert(library_fds() >= 1 && library_fds() <= 1 + 2 * lanes * partners);
+    assert(threads() >= 2 && threads() <= 2 + lanes * partners);
+
+    if (world_size > 1) {
+        char token = 'x';
+
+        ASSERT_MIMPI_OK(MIMPI_Sendrecv(&token, 1, right, 1, &token, 1, left, 1, MIMPI_COMM_WORLD));
+        ASSERT_MIMPI_OK(MIMPI_Sendrecv(&token, 1, left, 2, &token, 1, right, 2, MIMPI_COMM_WORLD));
+
+        // Two channels and a helper per lane of a partner, no matter how many processes there are.
+        assert(library_fds() == 1 + 2 * lanes * partners);
+        assert(threads() == 2 + lanes * partners);
+
+        // Both partners wait for a message sent only now, so they were alive, with their channels open,
+        // when the channels were counted.
+        ASSERT_MIMPI_OK(MIMPI_Sendrecv(&token, 1, right, 3, &token, 1, left, 3, MIMPI_COMM_WORLD));
+        ASSERT_MIMPI_OK(MIMPI_Sendrecv(&token, 1, left, 4, &token, 1, right, 4, MIMPI_COMM_WORLD));
+    }
+
+    MIMPI_Finalize();
+    printf("Done\n");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define DEGREE 4
+#define BLOCK 3000
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    int self = world_rank;
+    MIMPI_Comm graph;
+    assert(MIMPI_Dist_graph_create_adjacent(MIMPI_COMM_WORLD, 1, &self, 0, NULL, &graph)
+           == MIMPI_ERROR_ATTEMPTED_SELF_OP);
+
+    // Only process 0 gives an invalid neighbour, the others learn about it instead of waiting.
+    int other = (world_rank == 0) ? world_size : (world_rank + 1) % world_size;
+    MIMPI_Retcode ret = MIMPI_Dist_graph_create_adjacent(MIMPI_COMM_WORLD, 0, NULL, 1, &other, &graph);
+    if (world_rank == 0)
+        assert(ret == MIMPI_ERROR_NO_SUCH_RANK);
+    else
+        assert(ret == MIMPI_ERROR_INVALID_TOPOLOGY);
+    assert(graph == MIMPI_COMM_NULL);
+
+    uint8_t byte = 0;
+    assert(MIMPI_Neighbor_allgather(&byte, &byte, 1, MIMPI_COMM_WORLD) == MIMPI_ERROR_INVALID_TOPOLOGY);
+
+    if (world_size >= 3) {
+        // A 1D stencil with two neighbours on each side; with 3 processes
+        // some neighbours repeat, which has to keep blocks in order.
+        int const offsets[DEGREE] = {1, -1, 2, -2};
+        int destinations[DEGREE], sources[DEGREE];
+        for (int i = 0; i < DEGREE; ++i) {
+            destinations[i] = (world_rank + offsets[i] + 2 * world_size) % world_size;
+            sources[i] = (world_rank - offsets[i] + 2 * world_size) % world_size;
+        }
+        ASSERT_MIMPI_OK(MIMPI_Dist_graph_create_adjacent(MIMPI_COMM_WORLD, DEGREE, sources, DEGREE, destinations, &graph));
+
+        MIMPI_Comm dup;
+        ASSERT_MIMPI_OK(MIMPI_Comm_dup(graph, &dup));
+
+        static uint8_t send_data[DEGREE * BLOCK];
+        static uint8_t recv_data[DEGREE * BLOCK];
+
+        for (int iter = 0; iter < 10; ++iter) {
+            memset(send_data, world_rank + iter, BLOCK);
+            ASSERT_MIMPI_OK(MIMPI_Neighbor_allgather(send_data, recv_data, BLOCK, iter % 2 ? dup : graph));
+            for (int i = 0; i < DEGREE; ++i)
+                for (int j = 0; j < BLOCK; ++j)
+                    assert(recv_data[i * BLOCK + j] == (uint8_t) (sources[i] + iter));
+
+            for (int i = 0; i < DEGREE; ++i)
+                memset(send_data + i * BLOCK, 10 * world_rank + i + iter, BLOCK);
+            ASSERT_MIMPI_OK(MIMPI_Neighbor_alltoall(send_data, recv_data, BLOCK, iter % 2 ? graph : dup));
+            for (int i = 0; i < DEGREE; ++i)
+                for (int j = 0; j < BLOCK; ++j)
+                    assert(recv_data[i * BLOCK + j] == (uint8_t) (10 * sources[i] + i + iter));
+        }
+
+        ASSERT_MIMPI_OK(MIMPI_Comm_free(&dup));
+        ASSERT_MIMPI_OK(MIMPI_Comm_free(&graph));
+    }
+
+    MIMPI_Finalize();
+    printf("Done\n");
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define DATA_LEN 100000
+#define ELEMS 1000
+
+// Takes the right operand, so the result is the data of the last process.
+static void last(void const *in, void *inout, int count) {
+    memcpy(inout, in, count * sizeof(uint32_t));
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const root = world_size / 2;
+
+    // Termination detection style barrier, polled in between some work.
+    MIMPI_Request barrier;
+    ASSERT_MIMPI_OK(MIMPI_Ibarrier(MIMPI_COMM_WORLD, &barrier));
+    bool done = false;
+    volatile uint64_t work = 0;
+    while (!done) {
+        for (int i = 0; i < 1000; ++i)
+            work += i;
+        ASSERT_MIMPI_OK(MIMPI_Test(&barrier, &done));
+    }
+    assert(barrier == MIMPI_REQUEST_NULL);
+
+    uint8_t *data = malloc(DATA_LEN);
+    uint8_t *sum = malloc(DATA_LEN);
+    uint32_t values[ELEMS];
+    uint32_t result[ELEMS];
+    assert(data && sum);
+    memset(data, world_rank == root ? 42 : 0, DATA_LEN);
+    for (int i = 0; i < ELEMS; ++i)
+        values[i] = world_rank * ELEMS + i;
+
+    MIMPI_Op op;
+    ASSERT_MIMPI_OK(MIMPI_Op_create(last, sizeof(uint32_t), false, &op));
+
+    // Several operations pending at once, completed in a different order and
+    // overlapped with a blocking collective and point-to-point messages.
+    MIMPI_Request bcast, reduce, ordered;
+    ASSERT_MIMPI_OK(MIMPI_Ibcast(data, DATA_LEN, root, MIMPI_COMM_WORLD, &bcast));
+    uint8_t one = 1;
+    uint8_t *ones = malloc(DATA_LEN);
+    memset(ones, 1, DATA_LEN);
+    ASSERT_MIMPI_OK(MIMPI_Ireduce(ones, sum, DATA_LEN, MIMPI_SUM, 0, MIMPI_COMM_WORLD, &reduce));
+    memset(ones, 0, DATA_LEN); // Send data may be reused right away.
+    ASSERT_MIMPI_OK(MIMPI_Ireduce(values, result, sizeof(values), op, root, MIMPI_COMM_WORLD, &ordered));
+
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+    if (world_size > 1) {
+        int const right = (world_rank + 1) % world_size;
+        int const left = (world_rank - 1 + world_size) % world_size;
+        ASSERT_MIMPI_OK(MIMPI_Sendrecv(&one, 1, right, 7, &one, 1, left, 7, MIMPI_COMM_WORLD));
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Wait(&ordered));
+    ASSERT_MIMPI_OK(MIMPI_Wait(&reduce));
+    ASSERT_MIMPI_OK(MIMPI_Wait(&bcast));
+
+    for (int i = 0; i < DATA_LEN; ++i)
+        assert(data[i] == 42);
+    if (world_rank == 0)
+        for (int i = 0; i < DATA_LEN; ++i)
+            assert(sum[i] == world_size);
+    if (world_rank == root)
+        for (int i = 0; i < ELEMS; ++i)
+            assert(result[i] == (world_size - 1) * ELEMS + i);
+
+    assert(MIMPI_Wait(&bcast) == MIMPI_ERROR_INVALID_REQUEST);
+    ASSERT_MIMPI_OK(MIMPI_Op_free(&op));
+    free(data);
+    free(sum);
+    free(ones);
+
+    MIMPI_Finalize();
+    printf("Done\n");
+    return 0;
+}
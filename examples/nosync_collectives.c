@@ -0,0 +1,47 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define ROUNDS 20
+#define DATA_LEN 5000
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    ASSERT_MIMPI_OK(MIMPI_Comm_set_synchronizing(MIMPI_COMM_WORLD, false));
+
+    static uint8_t data[DATA_LEN];
+    static uint8_t result[DATA_LEN];
+
+    // Back-to-back collectives with changing roots, so messages of consecutive ones overlap.
+    for (int round = 0; round < ROUNDS; ++round) {
+        int const root = round % world_size;
+        int const len = (round % 2) ? DATA_LEN : 1;
+
+        if (world_rank == root)
+            memset(data, round, len);
+        ASSERT_MIMPI_OK(MIMPI_Bcast(data, len, root));
+        for (int i = 0; i < len; ++i)
+            assert(data[i] == round);
+
+        memset(data, world_rank + round, len);
+        ASSERT_MIMPI_OK(MIMPI_Reduce(data, result, len, MIMPI_MAX, (root + 1) % world_size));
+        if (world_rank == (root + 1) % world_size)
+            for (int i = 0; i < len; ++i)
+                assert(result[i] == world_size - 1 + round);
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Comm_set_synchronizing(MIMPI_COMM_WORLD, true));
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+
+    MIMPI_Finalize();
+    return 0;
+}
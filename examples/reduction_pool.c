@@ -0,0 +1,45 @@
+/*
+A reduction of a few megabytes with the default tuning, whose combines
+have to go to the pool of reduction threads if there is one.
+Process 0 prints how many bytes were combined on its pool.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define DATA_LEN (4 * 1024 * 1024)
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    uint8_t *data = malloc(DATA_LEN);
+    uint8_t *recv_data = malloc(DATA_LEN);
+    assert(data && recv_data);
+    for (int i = 0; i < DATA_LEN; ++i)
+        data[i] = i + world_rank;
+
+    ASSERT_MIMPI_OK(MIMPI_Reduce(data, recv_data, DATA_LEN, MIMPI_SUM, 0));
+
+    if (world_rank == 0)
+    {
+        int const rank_sum = world_size * (world_size - 1) / 2;
+        for (int i = 0; i < DATA_LEN; ++i)
+            assert(recv_data[i] == (uint8_t) (world_size * i + rank_sum));
+        printf("pooled %lld\n", MIMPI_Pooled_reduction_bytes());
+    }
+
+    free(recv_data);
+    free(data);
+    MIMPI_Finalize();
+    return 0;
+}
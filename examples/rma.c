@@ -0,0 +1,138 @@
+/*
+Processes access each other's memory through windows: puts and gets separated by fences,
+accumulates and a counter of fetch-and-ops issued by all processes at once,
+and read-modify-write under exclusive locks.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define SLOTS 16
+#define ROUNDS 200
+#define MAX_PROCESSES 16
+
+static void int_sum(void const *in, void *inout, int count) {
+    int32_t const *x = in;
+    int32_t *y = inout;
+    for (int i = 0; i < count; ++i)
+        y[i] += x[i];
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const next = (world_rank + 1) % world_size;
+
+    // Every process writes its rank to its slot in the memory of the next one.
+    uint8_t *base;
+    MIMPI_Win win;
+    ASSERT_MIMPI_OK(MIMPI_Win_create(SLOTS, MIMPI_COMM_WORLD, (void **) &base, &win));
+    memset(base, 0xff, SLOTS);
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+
+    uint8_t rank_byte = world_rank;
+    ASSERT_MIMPI_OK(MIMPI_Put(&rank_byte, 1, next, world_rank, win));
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+    int const prev = (world_rank + world_size - 1) % world_size;
+    for (int i = 0; i < SLOTS; ++i)
+        assert(base[i] == (i == prev ? prev : 0xff));
+
+    uint8_t got[SLOTS];
+    ASSERT_MIMPI_OK(MIMPI_Get(got, SLOTS, next, 0, win));
+    assert(got[world_rank] == world_rank);
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+
+    // Byte sums of everybody meet in the memory of process 0.
+    memset(base, 0, SLOTS);
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+    uint8_t ones[SLOTS];
+    memset(ones, 1, SLOTS);
+    ASSERT_MIMPI_OK(MIMPI_Accumulate(ones, SLOTS, 0, 0, MIMPI_SUM, win));
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+    if (world_rank == 0)
+        for (int i = 0; i < SLOTS; ++i)
+            assert(base[i] == world_size);
+
+    // Out of bounds, a wrong rank and a lock never taken.
+    assert(MIMPI_Put(ones, 2, 0, SLOTS - 1, win) == MIMPI_ERROR_INVALID_WIN);
+    assert(MIMPI_Get(got, 1, 0, -1, win) == MIMPI_ERROR_INVALID_WIN);
+    assert(MIMPI_Get(got, 1, world_size, 0, win) == MIMPI_ERROR_NO_SUCH_RANK);
+    assert(MIMPI_Win_unlock(0, win) == MIMPI_ERROR_INVALID_WIN);
+    assert(MIMPI_Win_fence(MIMPI_WIN_NULL) == MIMPI_ERROR_INVALID_WIN);
+    ASSERT_MIMPI_OK(MIMPI_Win_free(&win));
+    assert(win == MIMPI_WIN_NULL);
+
+    // Regions of different sizes, counted up by fetch-and-ops and under locks.
+    MIMPI_Op op;
+    ASSERT_MIMPI_OK(MIMPI_Op_create(int_sum, sizeof(int32_t), true, &op));
+    int32_t *counters;
+    int const size = (world_rank == 0) ? 2 * sizeof(int32_t) : 0;
+    ASSERT_MIMPI_OK(MIMPI_Win_create(size, MIMPI_COMM_WORLD, (void **) &counters, &win));
+    if (world_rank == 0)
+        counters[0] = counters[1] = 0;
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+    if (world_size > 1)
+        assert(MIMPI_Put(ones, 1, 1, 0, win) == MIMPI_ERROR_INVALID_WIN);
+    assert(MIMPI_Accumulate(ones, 3, 0, 0, op, win) == MIMPI_ERROR_INVALID_OP);
+
+    bool seen[ROUNDS * MAX_PROCESSES] = {false};
+    int32_t one = 1;
+    for (int i = 0; i < ROUNDS; ++i)
+    {
+        int32_t ticket;
+        ASSERT_MIMPI_OK(MIMPI_Fetch_and_op(&one, &ticket, 0, 0, op, win));
+        assert(ticket >= 0 && ticket < ROUNDS * world_size && !seen[ticket]);
+        seen[ticket] = true;
+
+        int32_t value;
+        ASSERT_MIMPI_OK(MIMPI_Win_lock(MIMPI_LOCK_EXCLUSIVE, 0, win));
+        assert(MIMPI_Win_lock(MIMPI_LOCK_SHARED, 0, win) == MIMPI_ERROR_INVALID_WIN);
+        ASSERT_MIMPI_OK(MIMPI_Get(&value, sizeof(value), 0, sizeof(int32_t), win));
+        value++;
+        ASSERT_MIMPI_OK(MIMPI_Put(&value, sizeof(value), 0, sizeof(int32_t), win));
+        ASSERT_MIMPI_OK(MIMPI_Win_unlock(0, win));
+    }
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+
+    int32_t totals[2];
+    ASSERT_MIMPI_OK(MIMPI_Win_lock(MIMPI_LOCK_SHARED, 0, win));
+    ASSERT_MIMPI_OK(MIMPI_Get(totals, sizeof(totals), 0, 0, win));
+    ASSERT_MIMPI_OK(MIMPI_Win_unlock(0, win));
+    assert(totals[0] == ROUNDS * world_size && totals[1] == ROUNDS * world_size);
+    ASSERT_MIMPI_OK(MIMPI_Win_free(&win));
+    ASSERT_MIMPI_OK(MIMPI_Op_free(&op));
+
+    // A window of a part of the processes.
+    MIMPI_Comm half;
+    ASSERT_MIMPI_OK(MIMPI_Comm_split(MIMPI_COMM_WORLD, world_rank % 2, world_rank, &half));
+    int const half_rank = MIMPI_Comm_rank(half);
+    uint8_t *cell;
+    ASSERT_MIMPI_OK(MIMPI_Win_create(1, half, (void **) &cell, &win));
+    *cell = 0;
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+    ASSERT_MIMPI_OK(MIMPI_Accumulate(&rank_byte, 1, 0, 0, MIMPI_MAX, win));
+    ASSERT_MIMPI_OK(MIMPI_Win_fence(win));
+    if (half_rank == 0)
+    {
+        int largest = world_size - 1;
+        if (largest % 2 != world_rank % 2)
+            largest--;
+        assert(*cell == largest);
+    }
+    ASSERT_MIMPI_OK(MIMPI_Win_free(&win));
+    ASSERT_MIMPI_OK(MIMPI_Comm_free(&half));
+
+    if (world_rank == 0)
+        printf("Done\n");
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define DATA_LEN 1000
+
+// Affine maps x -> a * x + b modulo 2^32, composition of which is not commutative.
+typedef struct {
+    uint32_t a, b;
+} affine_t;
+
+// Applies inout first and in second.
+static void compose(void const *in, void *inout, int count) {
+    affine_t const *x = in;
+    affine_t *y = inout;
+    for (int i = 0; i < count; ++i) {
+        affine_t r = {x[i].a * y[i].a, x[i].a * y[i].b + x[i].b};
+        y[i] = r;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+
+    uint8_t send_data[DATA_LEN];
+    uint8_t recv_data[DATA_LEN];
+    memset(send_data, world_rank + 1, DATA_LEN);
+
+    ASSERT_MIMPI_OK(MIMPI_Scan(send_data, recv_data, DATA_LEN, MIMPI_SUM, MIMPI_COMM_WORLD));
+    for (int i = 0; i < DATA_LEN; ++i)
+        assert(recv_data[i] == (uint8_t) ((world_rank + 1) * (world_rank + 2) / 2));
+
+    memset(recv_data, 0, DATA_LEN);
+    ASSERT_MIMPI_OK(MIMPI_Exscan(send_data, recv_data, DATA_LEN, MIMPI_SUM, MIMPI_COMM_WORLD));
+    for (int i = 0; i < DATA_LEN; ++i)
+        assert(recv_data[i] == (uint8_t) (world_rank * (world_rank + 1) / 2));
+
+    MIMPI_Op op;
+    ASSERT_MIMPI_OK(MIMPI_Op_create(compose, sizeof(affine_t), false, &op));
+
+    affine_t map = {world_rank + 2, world_rank};
+    affine_t prefix;
+    affine_t expected = {1, 0};
+    for (int r = 0; r < world_rank; ++r) {
+        affine_t m = {r + 2, r};
+        compose(&m, &expected, 1);
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Exscan(&map, &prefix, sizeof(affine_t), op, MIMPI_COMM_WORLD));
+    if (world_rank > 0)
+        assert(prefix.a == expected.a && prefix.b == expected.b);
+
+    compose(&map, &expected, 1);
+    ASSERT_MIMPI_OK(MIMPI_Scan(&map, &prefix, sizeof(affine_t), op, MIMPI_COMM_WORLD));
+    assert(prefix.a == expected.a && prefix.b == expected.b);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+// Much more than fits in a pipe, so plain sends in a ring would block.
+#define DATA_LEN (1 << 20)
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const right = (world_rank + 1) % world_size;
+    int const left = (world_rank - 1 + world_size) % world_size;
+
+    uint8_t *send_data = malloc(DATA_LEN);
+    uint8_t *recv_data = malloc(DATA_LEN);
+    assert(send_data && recv_data);
+    memset(send_data, world_rank, DATA_LEN);
+
+    ASSERT_MIMPI_OK(MIMPI_Sendrecv(send_data, DATA_LEN, right, 1, recv_data, DATA_LEN, left, 1, MIMPI_COMM_WORLD));
+    for (int i = 0; i < DATA_LEN; ++i)
+        assert(recv_data[i] == left);
+
+    // Passing the buffer around the whole ring brings it back.
+    for (int i = 0; i < world_size; ++i)
+        ASSERT_MIMPI_OK(MIMPI_Sendrecv_replace(send_data, DATA_LEN, right, 2, left, 2, MIMPI_COMM_WORLD));
+    for (int i = 0; i < DATA_LEN; ++i)
+        assert(send_data[i] == world_rank);
+
+    assert(MIMPI_Sendrecv(send_data, 1, world_rank, 1, recv_data, 1, left, 1, MIMPI_COMM_WORLD)
+           == MIMPI_ERROR_ATTEMPTED_SELF_OP);
+
+    free(send_data);
+    free(recv_data);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+Every process sends messages of a few sizes, big and small, to the next one,
+which checks every byte of them. With mimpirun --stripes the big ones are
+split across several channels and put back together by the receiver.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define NUM_SIZES 4
+
+static const int sizes[NUM_SIZES] = {4 << 20, 100000, 1000003, 256 * 1024};
+
+static uint8_t byte_at(int i, int rank, int size)
+{
+    return (uint8_t) (i * 31 + rank * 7 + size);
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const next = (world_rank + 1) % world_size;
+    int const prev = (world_rank + world_size - 1) % world_size;
+
+    uint8_t *data = malloc(sizes[0]);
+    assert(data);
+
+    for (int k = 0; k < NUM_SIZES; ++k)
+    {
+        for (int i = 0; i < sizes[k]; ++i)
+            data[i] = byte_at(i, world_rank, sizes[k]);
+        ASSERT_MIMPI_OK(MIMPI_Send(data, sizes[k], next, k + 1));
+    }
+
+    // In the reverse order, so that the messages have to wait for their receives.
+    for (int k = NUM_SIZES - 1; k >= 0; --k)
+    {
+        ASSERT_MIMPI_OK(MIMPI_Recv(data, sizes[k], prev, k + 1));
+        for (int i = 0; i < sizes[k]; ++i)
+            assert(data[i] == byte_at(i, prev, sizes[k]));
+    }
+
+    free(data);
+    printf("Done\n");
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define ELEMS 3000
+
+// 2x2 matrices modulo 2^32, multiplication of which is not commutative.
+typedef struct {
+    uint32_t a, b, c, d;
+} matrix_t;
+
+typedef struct {
+    int32_t value;
+    int32_t rank;
+} argmax_t;
+
+static void matrix_mul(void const *in, void *inout, int count) {
+    matrix_t const *x = in;
+    matrix_t *y = inout;
+    for (int i = 0; i < count; ++i) {
+        matrix_t r = {
+            y[i].a * x[i].a + y[i].b * x[i].c, y[i].a * x[i].b + y[i].b * x[i].d,
+            y[i].c * x[i].a + y[i].d * x[i].c, y[i].c * x[i].b + y[i].d * x[i].d,
+        };
+        y[i] = r;
+    }
+}
+
+static void argmax(void const *in, void *inout, int count) {
+    argmax_t const *x = in;
+    argmax_t *y = inout;
+    for (int i = 0; i < count; ++i)
+        if (x[i].value > y[i].value || (x[i].value == y[i].value && x[i].rank < y[i].rank))
+            y[i] = x[i];
+}
+
+static matrix_t rank_matrix(int rank, int i) {
+    matrix_t m = {1, rank + i, 0, 1 + rank};
+    return m;
+}
+
+static matrix_t send_data[ELEMS];
+static matrix_t recv_data[ELEMS];
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    MIMPI_Op mul;
+    MIMPI_Op max_loc;
+    ASSERT_MIMPI_OK(MIMPI_Op_create(matrix_mul, sizeof(matrix_t), false, &mul));
+    ASSERT_MIMPI_OK(MIMPI_Op_create(argmax, sizeof(argmax_t), true, &max_loc));
+
+    for (int i = 0; i < ELEMS; ++i)
+        send_data[i] = rank_matrix(world_rank, i);
+
+    for (int root = 0; root < world_size; ++root) {
+        ASSERT_MIMPI_OK(MIMPI_Reduce(send_data, recv_data, sizeof(send_data), mul, root));
+        if (world_rank == root) {
+            for (int i = 0; i < ELEMS; ++i) {
+                matrix_t expected = rank_matrix(0, i);
+                for (int r = 1; r < world_size; ++r) {
+                    matrix_t m = rank_matrix(r, i);
+                    matrix_mul(&m, &expected, 1);
+                }
+                assert(memcmp(&expected, &recv_data[i], sizeof(matrix_t)) == 0);
+            }
+        }
+    }
+
+    argmax_t value = {world_rank % 3, world_rank};
+    argmax_t result;
+    ASSERT_MIMPI_OK(MIMPI_Reduce(&value, &result, sizeof(argmax_t), max_loc, 0));
+    if (world_rank == 0)
+        assert(result.value == (world_size > 2 ? 2 : world_size - 1) && result.rank == result.value);
+
+    assert(MIMPI_Reduce(&value, &result, sizeof(argmax_t) - 1, max_loc, 0) == MIMPI_ERROR_INVALID_OP);
+    ASSERT_MIMPI_OK(MIMPI_Op_free(&mul));
+    assert(mul == MIMPI_OP_NULL);
+    assert(MIMPI_Reduce(&value, &result, 1, mul, 0) == MIMPI_ERROR_INVALID_OP);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -2,13 +2,27 @@
  * This file is for implementation of MIMPI library.
  * */
 
+#define _GNU_SOURCE // For CPU affinity.
 #include "channel.h"
 #include "mimpi.h"
 #include "mimpi_common.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 
 /* Structs */
 typedef enum {
@@ -17,27 +31,23 @@ typedef enum {
 
 } send_signal_t;
 
-typedef enum {
-    MESSAGE_ARRIVED = 0,
-    PROCESS_ENDED = 1,
-    DEADLOCK_DETECTED_BY_ONE_SIDE = 2,
-    DEADLOCK_DETECTED_BY_BOTH_SIDES = 3,
-    RETRY_SENDING_WAITING = 4
-
-} recv_signal_t;
-
 typedef struct metadata
 {
     send_signal_t signal;
+    int context;
     int tag;
     int count;
     int num_recv;
     int num_sent;
+    bool compressed; // Whether the data following the metadata is compressed, see lz_compress.
+    int frame_size; // Bytes of data following the metadata, fewer than count if compressed.
+    int stripes; // Parts the message is split into, one per data lane, see send_striped.
 
 } metadata_t;
 
 typedef struct buffer_node
 {
+    int context;
     int tag;
     int sender;
     int count;
@@ -47,18 +57,349 @@ typedef struct buffer_node
 
 } buffer_node_t;
 
+typedef enum {
+    DELIVERY_MESSAGE = 0,
+    DELIVERY_WAITING = 1, // For deadlock detection.
+    DELIVERY_END = 2 // The process has closed its channel.
+
+} delivery_kind_t;
+
+typedef struct delivery
+{
+    delivery_kind_t kind;
+    buffer_node_t* node; // If kind == DELIVERY_MESSAGE.
+    int num_recv; // If kind == DELIVERY_WAITING.
+    int num_sent; // If kind == DELIVERY_WAITING.
+
+} delivery_t;
+
+typedef struct overflow_node
+{
+    delivery_t delivery;
+    struct overflow_node* next;
+
+} overflow_node_t;
+
+typedef enum {
+    LANE_DATA = 0, // Also the first stripe of a striped message.
+    LANE_CONTROL = 1, // WAITING frames and small messages, which would otherwise wait behind bulk data.
+    LANE_STRIPES = 2 // The lanes from here on carry the other stripes.
+
+} lane_t;
+
+// Puts the stripes of a message read by the helpers of their lanes together.
+// The helper of LANE_DATA publishes the buffer of every striped message and waits for the others.
+typedef struct reassembly
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond; // Broadcast whenever anything below changes.
+    u_int8_t* buff; // Of the striped message being read.
+    int generation; // Striped messages published so far.
+    int num_read[MIMPI_MAX_LANES]; // Stripes read so far by the helper of each stripe lane.
+    bool closed[MIMPI_MAX_LANES]; // Whether the lane has reached its end.
+
+} reassembly_t;
+
+typedef struct frame
+{
+    metadata_t mt;
+    const u_int8_t* data; // Compressed by frame_prepare, if that makes it smaller.
+    int size; // Bytes of data, mt.frame_size once prepared.
+    int fd;
+    int dest;
+    u_int8_t* compressed; // Owned by the frame.
+    bool ret; // Whether the frame has been written.
+
+} frame_t;
+
+// A ring of io_uring, see uring_create. Writes of a thread go through a ring of its own.
+typedef struct uring
+{
+    int fd;
+    void* queues; // Both the submission and the completion queue, see IORING_FEAT_SINGLE_MMAP.
+    size_t queues_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    atomic_uint* sq_head;
+    atomic_uint* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    atomic_uint* cq_head;
+    atomic_uint* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    bool fixed[MIMPI_SCRATCH_FD_MIN]; // Whether the descriptor is in the table of fixed files, at its own number.
+
+} uring_t;
+
+// Hands events over from the helper of a lane, its only producer, to the thread matching
+// receives at the moment, its only consumer. Events that do not fit in the ring wait in the
+// overflow list, so that the helper never stops draining the channel.
+typedef struct delivery_queue
+{
+    delivery_t slots[MIMPI_DELIVERY_QUEUE_SIZE];
+    atomic_uint head; // Next slot to be taken, written only by the consumer.
+    atomic_uint tail; // Next slot to be filled, written only by the producer.
+    atomic_int num_overflowing; // Events in the overflow list, all of them newer than the ones in the ring.
+    pthread_mutex_t overflow_mutex;
+    overflow_node_t* overflow_first;
+    overflow_node_t* overflow_last;
+
+} delivery_queue_t;
+
+typedef struct user_op
+{
+    bool used;
+    MIMPI_User_function fn;
+    int elem_size;
+    bool commutative;
+
+} user_op_t;
+
+typedef struct reduction_job
+{
+    bool active;
+    u_int8_t* first;
+    const u_int8_t* second;
+    int size;
+    MIMPI_Op op;
+    int chunk_size; // A multiple of the element size of the operation.
+    int next_chunk; // Chunks are taken in order by the reducers and the main thread.
+    int num_chunks;
+    int chunks_done;
+
+} reduction_job_t;
+
+typedef enum {
+    TREE_BINARY = 0, // Binary heap over ranks in which 0 and root swap places.
+    TREE_BINOMIAL = 1,
+    TREE_CHAIN = 2, // root -> root + 1 -> ... (mod size), meant for pipelining.
+    NUM_TREE_SHAPES = 3
+
+} tree_shape_t;
+
+typedef struct tree_links
+{
+    int parent; // -1 if this process is the root of the tree.
+    int children[MIMPI_MAX_TREE_CHILDREN]; // Children with the largest subtrees come first.
+    int num_children;
+
+} tree_links_t;
+
+typedef struct comm
+{
+    bool used;
+    int context; // Distinguishes messages of this communicator from messages of the others.
+    int rank;
+    int size;
+    int world_ranks[MIMPI_MAX_N]; // Maps ranks in the communicator to ranks in the world.
+    bool synchronizing; // Whether broadcast and reduce are also barriers.
+    int num_requests; // Non-blocking collectives started so far, which determines their tags.
+    bool has_topology; // Whether the neighbours below have been declared.
+    int indegree;
+    int outdegree;
+    int sources[MIMPI_MAX_NEIGHBORS];
+    int destinations[MIMPI_MAX_NEIGHBORS];
+    int send_order[MIMPI_MAX_NEIGHBORS]; // Destinations by distance from this process, see topology_setup.
+    tree_links_t trees[NUM_TREE_SHAPES][MIMPI_MAX_N]; // trees[shape][root] is this process' place in the tree.
+
+} comm_t;
+
+typedef enum {
+    COLL_BARRIER = 0,
+    COLL_BCAST = 1,
+    COLL_REDUCE = 2,
+    COLL_ALLGATHER = 3,
+    COLL_ALLTOALL = 4,
+    COLL_GATHER = 5,
+    COLL_SCATTER = 6,
+    COLL_SCAN = 7,
+    NUM_COLLECTIVES = 8
+
+} collective_kind_t;
+
+typedef struct collective_args
+{
+    void* data; // Broadcast data.
+    void const* send_data; // Reduction data or blocks to be exchanged.
+    void* recv_data; // Reduction result or exchanged blocks.
+    int count; // Size of a single block in case of the exchanging collectives.
+    MIMPI_Op op;
+    int root;
+    int send_count; // Size of the block of this process in a gather.
+    int recv_count; // Size of the block of this process in a scatter.
+    bool variable; // Whether blocks of a gather or scatter have counts and displs given per process.
+    const int* counts;
+    const int* displs;
+    bool exclusive; // Whether a scan leaves out the data of this process.
+
+} collective_args_t;
+
+struct algorithm;
+
+typedef MIMPI_Retcode (*collective_fn_t)(const comm_t* comm,
+                                         const collective_args_t* args,
+                                         const struct algorithm* algo);
+
+typedef struct algorithm
+{
+    const char* name;
+    collective_fn_t fn;
+    tree_shape_t shape; // Tree carrying the data.
+    tree_shape_t sync_shape; // Tree carrying the dummy messages making the collective a barrier.
+    bool pipelined; // Whether data is sent in segments of MIMPI_SEGMENT_SIZE bytes.
+
+} algorithm_t;
+
+typedef struct collective
+{
+    const char* name;
+    const algorithm_t* algorithms;
+    int num_algorithms;
+
+} collective_t;
+
+typedef enum {
+    STEP_SEND = 0,
+    STEP_RECV = 1,
+    STEP_RECV_REDUCE = 2 // Combines the received data into buf.
+
+} step_kind_t;
+
+typedef struct step
+{
+    step_kind_t kind;
+    int round; // A step starts once every step of the earlier rounds has finished.
+    int peer; // Rank in the communicator.
+    u_int8_t* buf;
+    int count;
+    bool finished;
+
+} step_t;
+
+// A non-blocking collective, run as a schedule of steps by the progress thread.
+typedef struct request
+{
+    bool used;
+    bool done;
+    MIMPI_Retcode ret;
+    const comm_t* comm;
+    int tag; // Distinct for the non-blocking collectives pending at the same time.
+    MIMPI_Op op;
+    bool commutative; // Otherwise receives combined in a round go in the order of the steps.
+    step_t* steps; // Sorted by round.
+    int num_steps;
+    int max_steps;
+    int first; // First step of the current round.
+    u_int8_t* tmp; // Scratch space released on completion.
+
+} request_t;
+
+// Beginning of the shared memory of a window, followed by the regions of the processes.
+typedef struct win_shared
+{
+    pthread_rwlock_t locks[MIMPI_MAX_N]; // Taken by MIMPI_Win_lock, per region.
+    pthread_mutex_t atomics[MIMPI_MAX_N]; // Keeps accumulates on a region from interleaving.
+
+} win_shared_t;
+
+typedef struct window
+{
+    bool used;
+    MIMPI_Comm comm; // A duplicate of the one the window was created on, freed with the window.
+    win_shared_t* shared;
+    size_t mapped_size;
+    u_int8_t* regions[MIMPI_MAX_N]; // By the rank in comm.
+    int sizes[MIMPI_MAX_N];
+    int held[MIMPI_MAX_N]; // Kind of lock of the region this process holds, or -1.
+
+} window_t;
+
+// Algorithm used for a collective in a communicator of at most max_size processes
+// when the message has at most max_count bytes. The first matching entry wins.
+typedef struct tuning_entry
+{
+    collective_kind_t collective;
+    int max_size;
+    int max_count;
+    int algorithm; // Index in the collective's algorithms.
+
+} tuning_entry_t;
+
+// Operations created by MIMPI_Op_create get handles from MIMPI_OP_USER_FIRST upwards.
+#define MIMPI_OP_USER_FIRST (MIMPI_PROD + 1)
+
+// Non-blocking collectives use tags from -2 downwards, so that they never mix with the blocking ones.
+#define MIMPI_REQUEST_TAGS (1 << 24)
+
+// Pipelined collectives send segments fitting in a single chsend together with their metadata.
+#define MIMPI_SEGMENT_SIZE (MIMPI_WRITE_BUFFER_SIZE - (int) sizeof(metadata_t))
+
 /* Global Data */
+static int g_rank;
+static int g_size;
+static comm_t g_comms[MIMPI_MAX_COMMS]; // g_comms[MIMPI_COMM_WORLD] spans every process.
+static int g_next_context; // The lowest context not used by any communicator of this process.
 static pthread_mutex_t g_mutex;
-static pthread_mutex_t g_on_recv;
-static buffer_node_t* g_first_node;
+static pthread_cond_t g_on_recv; // Signalled under g_mutex when g_recv_sleeping may stop sleeping.
+static buffer_node_t* g_first_node; // Messages moved out of g_queues, owned by whoever holds g_mutex.
 static buffer_node_t* g_last_node;
-static pthread_t thread[MIMPI_MAX_N];
-static u_int8_t g_write_buf[MIMPI_WRITE_BUFFER_SIZE];
+static delivery_queue_t g_queues[MIMPI_MAX_N][MIMPI_MAX_LANES]; // g_queues[src][lane] is filled by its helper.
+static int g_num_delivered[MIMPI_MAX_N]; // Events taken from g_queues[src] so far.
+static int g_lanes_ended[MIMPI_MAX_N];
+static bool g_ended[MIMPI_MAX_N]; // Whether every message from the process has been delivered.
+static pthread_t thread[MIMPI_MAX_N][MIMPI_MAX_LANES];
+static int g_num_stripes; // Data lanes to every process, set by mimpirun --stripes.
+static int g_num_lanes;
+static reassembly_t g_reassembly[MIMPI_MAX_N];
+static pthread_t g_listener; // Takes channels passed by mimpirun and starts helpers for them.
+static pthread_cond_t g_connect; // Signalled under g_mutex whenever channels with a process are set up.
+static bool g_connect_requested[MIMPI_MAX_N];
+static bool g_connected[MIMPI_MAX_N]; // Whether there are channels with the process, or it is known to be gone.
+static bool g_has_helper[MIMPI_MAX_N];
+static __thread u_int8_t g_write_buf[MIMPI_WRITE_BUFFER_SIZE]; // Both the main and the progress thread send.
+static pthread_mutex_t g_write_mutex[MIMPI_MAX_N][MIMPI_MAX_LANES]; // Keeps messages on a lane from interleaving.
+static bool g_write_open[MIMPI_MAX_N][MIMPI_MAX_LANES]; // Closed by MIMPI_Finalize or the helper, whichever comes first.
+static bool g_uring_enabled; // Whether MIMPI_URING asks for writes through io_uring.
+static pthread_mutex_t g_urings_mutex; // Guards g_urings and the tables of fixed files of the rings.
+static uring_t* g_urings[MIMPI_MAX_URINGS];
+static __thread uring_t* g_uring; // Of the thread, if it has one.
+static __thread bool g_uring_tried;
 static volatile bool g_alive[MIMPI_MAX_N];
-static volatile int g_source; // If g_source != -1, main program is waiting for a message from g_source.
-static volatile int g_tag; // If g_source != -1, main program is waiting for a message with g_tag.
-static volatile int g_count; // If g_source != -1, main program is waiting for a message of g_count bytes.
-static volatile recv_signal_t g_recv_sig;
+static int g_source; // If g_source != -1, main program is waiting for a message from g_source.
+static int g_source_count; // Of the message main program is waiting for, if g_source != -1.
+static int g_source_tag;
+static int g_source_context;
+static atomic_int g_recv_sleeping; // The process whose events main program is sleeping for, or -1.
+static int g_spin_budget; // Times the waiting receive checks its queue before going to sleep.
+static int g_max_spin; // Zero if there are more processes than CPUs, as spinning would steal them.
+static int g_compress_threshold; // Smallest message sent compressed, or 0 if compression is off.
+static atomic_llong g_compress_raw; // Bytes of the messages that have been considered for compression.
+static atomic_llong g_compress_sent; // Bytes actually written for them.
+
+static user_op_t g_ops[MIMPI_MAX_USER_OPS];
+
+// Reduction pool stuff:
+static pthread_t g_reducers[MIMPI_MAX_REDUCTION_THREADS];
+static int g_num_reducers;
+static atomic_llong g_pool_bytes; // Bytes of the combines handed to the pool.
+static pthread_mutex_t g_pool_mutex;
+static pthread_cond_t g_pool_work;
+static pthread_cond_t g_pool_done;
+static reduction_job_t g_job;
+static bool g_pool_exit;
+
+// Non-blocking collectives stuff:
+static request_t g_requests[MIMPI_MAX_REQUESTS];
+static pthread_t g_progress_thread;
+static bool g_progress_started;
+static bool g_progress_exit;
+static pthread_cond_t g_progress; // Signalled under g_mutex whenever there may be something to progress.
+static atomic_bool g_progress_sleeping; // Whether the progress thread sleeps with requests pending.
+static pthread_cond_t g_request_done;
+
+// One-sided communication stuff:
+static window_t g_windows[MIMPI_MAX_WINDOWS];
 
 // Deadlock detection stuff:
 static bool g_deadlock_detection;
@@ -66,14 +407,16 @@ static volatile bool g_is_waiting_on_recv[MIMPI_MAX_N];
 static volatile int g_num_sent[MIMPI_MAX_N];
 static volatile int g_num_recv[MIMPI_MAX_N];
 static volatile int g_num_sent_to_me[MIMPI_MAX_N];
+static bool g_deadlock_both; // Set when a WAITING from g_source shows that both sides wait.
 
 /* Auxiliary Functions */
 static bool tag_compare(int t1, int t2) {
     return (t1 == MIMPI_ANY_TAG && t2 > 0) || t1 == t2;
 }
 
-static buffer_node_t* new_node(int tag, int sender, int count, void* data) {
+static buffer_node_t* new_node(int context, int tag, int sender, int count, void* data) {
     buffer_node_t* new_n = malloc(sizeof(buffer_node_t));
+    new_n->context = context;
     new_n->tag = tag;
     new_n->sender = sender;
     new_n->count = count;
@@ -85,7 +428,22 @@ static buffer_node_t* new_node(int tag, int sender, int count, void* data) {
 
 static void cleanup() {
     ASSERT_SYS_OK(pthread_mutex_destroy(&g_mutex));
-    ASSERT_SYS_OK(pthread_mutex_destroy(&g_on_recv));
+    ASSERT_ZERO(pthread_cond_destroy(&g_on_recv));
+    ASSERT_ZERO(pthread_cond_destroy(&g_progress));
+    ASSERT_ZERO(pthread_cond_destroy(&g_request_done));
+    ASSERT_ZERO(pthread_cond_destroy(&g_connect));
+    ASSERT_ZERO(pthread_mutex_destroy(&g_urings_mutex));
+    for (int i = 0; i < g_size; i++) {
+        for (int lane = 0; lane < g_num_lanes; lane++) {
+            ASSERT_ZERO(pthread_mutex_destroy(&g_write_mutex[i][lane]));
+            ASSERT_ZERO(pthread_mutex_destroy(&g_queues[i][lane].overflow_mutex));
+        }
+        ASSERT_ZERO(pthread_mutex_destroy(&g_reassembly[i].mutex));
+        ASSERT_ZERO(pthread_cond_destroy(&g_reassembly[i].cond));
+    }
+    for (int i = 0; i < MIMPI_MAX_WINDOWS; i++) {
+        if (g_windows[i].used) ASSERT_SYS_OK(munmap(g_windows[i].shared, g_windows[i].mapped_size));
+    }
     buffer_node_t* itr = g_first_node;
     buffer_node_t* aux;
 
@@ -101,7 +459,42 @@ static int minimum(int a, int b) {
     return (a < b) ? a : b;
 }
 
+static int read_fd(int src, int lane) {
+    switch (lane) {
+        case LANE_DATA: return MIMPI_READ_OFFSET + MIMPI_MAX_N * src + g_rank;
+        case LANE_CONTROL: return MIMPI_CONTROL_READ_OFFSET + src;
+        default: return MIMPI_STRIPE_READ_OFFSET + MIMPI_MAX_N * (lane - LANE_STRIPES) + src;
+    }
+}
+
+static int write_fd(int dest, int lane) {
+    switch (lane) {
+        case LANE_DATA: return MIMPI_WRITE_OFFSET + MIMPI_MAX_N * g_rank + dest;
+        case LANE_CONTROL: return MIMPI_CONTROL_WRITE_OFFSET + dest;
+        default: return MIMPI_STRIPE_WRITE_OFFSET + MIMPI_MAX_N * (lane - LANE_STRIPES) + dest;
+    }
+}
+
+static int lane_of(int count) {
+    return (count <= MIMPI_CONTROL_MAX_COUNT) ? LANE_CONTROL : LANE_DATA;
+}
+
+static int stripe_lane(int stripe) {
+    return (stripe == 0) ? LANE_DATA : LANE_STRIPES + stripe - 1;
+}
+
+// Finds the part of a message of count bytes carried by the stripe. Parts are aligned to whole pages,
+// so the last ones may be shorter or empty.
+static void stripe_part(int count, int stripes, int stripe, int* offset, int* size) {
+    int part = (count + stripes - 1) / stripes;
+    part = (part + MIMPI_STRIPE_ALIGN - 1) / MIMPI_STRIPE_ALIGN * MIMPI_STRIPE_ALIGN;
+
+    *offset = minimum(count, stripe * part);
+    *size = minimum(count - *offset, part);
+}
+
 // Tries to read the specified amount of bytes and no less.
+// What does not fit in the buffer is read straight into res_buf, with as few reads as possible.
 // Returns false in case no write descriptor for the channel is open.
 static bool thorough_read(void* read_buf, int* offset, int* fillup, void* res_buf, int count, int fd) {
     int left_in_buf = *fillup - *offset;
@@ -111,6 +504,14 @@ static bool thorough_read(void* read_buf, int* offset, int* fillup, void* res_bu
     int ret;
 
     while (to_read > 0) {
+        if (left_in_buf == 0 && to_read >= MIMPI_READ_BUFFER_SIZE) {
+            ret = chrecv(fd, res_buf + bytes_read, to_read);
+            ASSERT_SYS_OK(ret);
+            if (ret == 0) return false;
+            bytes_read += ret;
+            to_read -= ret;
+            continue;
+        }
         if (left_in_buf == 0) {
             ret = chrecv(fd, read_buf, MIMPI_READ_BUFFER_SIZE);
             ASSERT_SYS_OK(ret);
@@ -149,9 +550,9 @@ static bool send_aux(size_t bytes_to_send, int fd, int dest) {
     return true;
 }
 
-// Tries to write the metadata and data of count bytes and no less.
+// Writes the metadata and the frame_size bytes of data following it.
 // Returns false in case no read descriptor for the channel is open.
-static bool thorough_write(metadata_t mt, const void* data, int count, int fd, int dest) {
+static bool write_frame(metadata_t mt, const void* data, int count, int fd, int dest) {
     int bytes_to_copy = minimum(count, MIMPI_WRITE_BUFFER_SIZE - sizeof(metadata_t));
     int offset = 0;
 
@@ -177,519 +578,3785 @@ static bool thorough_write(metadata_t mt, const void* data, int count, int fd, i
     return true;
 }
 
-// Never to be performed on g_first_node or g_last_node!!!
-static void del_node(buffer_node_t* node) {
-    node->prev->next = node->next;
-    node->next->prev = node->prev;
-    free(node->data);
-    free(node);
+// A byte-oriented LZ77 codec in the spirit of LZ4. The data is a series of sequences, each being
+// a token, the literals and the match copied from offset bytes back. The high half of the token
+// is the number of literals and the low half the length of the match minus LZ_MIN_MATCH, with 15
+// meaning that more length follows in bytes of which all but the last are 255. The last sequence
+// has no match.
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+static inline u_int32_t lz_read32(const u_int8_t* p) {
+    u_int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
 }
 
-static inline int left_child(int rank) { return rank * 2 + 1; }
+static inline int lz_hash(u_int32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
 
-static inline int right_child(int rank) { return left_child(rank) + 1; }
+static u_int8_t* lz_put_length(u_int8_t* out, const u_int8_t* end, int len) {
+    for (; len >= 255; len -= 255) {
+        if (out >= end) return NULL;
+        *out++ = 255;
+    }
+    if (out >= end) return NULL;
+    *out++ = len;
+    return out;
+}
 
-static inline bool has_left_child(int rank) {
-    int size = MIMPI_World_size();
+// Returns the end of the sequence in the output, or NULL if it does not fit.
+static u_int8_t* lz_put_sequence(u_int8_t* out, const u_int8_t* end,
+                                 const u_int8_t* literals, int num_literals, int offset, int match_len) {
+    int extra = (match_len > 0) ? match_len - LZ_MIN_MATCH : 0;
 
-    return left_child(rank) < size;
-}
+    if (out >= end) return NULL;
+    *out++ = (minimum(num_literals, 15) << 4) | minimum(extra, 15);
 
-static inline bool has_right_child(int rank) {
-    int size = MIMPI_World_size();
+    if (num_literals >= 15 && (out = lz_put_length(out, end, num_literals - 15)) == NULL) return NULL;
+    if (end - out < num_literals) return NULL;
+    memcpy(out, literals, num_literals);
+    out += num_literals;
 
-    return right_child(rank) < size;
-}
+    if (match_len == 0) return out;
 
-static inline int parent(int rank) {
-    return (rank - 1) / 2;
+    if (end - out < 2) return NULL;
+    *out++ = offset & 0xff;
+    *out++ = offset >> 8;
+    if (extra >= 15 && (out = lz_put_length(out, end, extra - 15)) == NULL) return NULL;
+    return out;
 }
 
-static inline bool is_root(int rank) {
-    return rank == 0;
-}
+// Returns the size of the compressed data, or -1 if it does not fit in capacity bytes.
+// Skips ahead faster the longer it goes without a match, so incompressible data costs little.
+static int lz_compress(const u_int8_t* in, int size, u_int8_t* out, int capacity) {
+    int table[1 << LZ_HASH_BITS];
+    const u_int8_t* end = out + capacity;
+    u_int8_t* pos = out;
+    int anchor = 0; // Start of the literals of the current sequence.
+    int i = 0;
 
-static int rank_adjust(int og_rank, int root) {
-    if (og_rank == root) return 0;
-    else if (og_rank == 0) return root;
-    else return og_rank;
-}
+    for (int h = 0; h < (1 << LZ_HASH_BITS); h++) {
+        table[h] = -1;
+    }
 
-static void reduction(u_int8_t* first, const u_int8_t* second, int size, MIMPI_Op op) {
-    for (int i = 0; i < size; i++) {
-        switch (op) {
-            case MIMPI_MAX:
-                if(first[i] < second[i]) first[i] = second[i];
-                break;
-            case MIMPI_MIN:
-                if(first[i] > second[i]) first[i] = second[i];
-                break;
-            case MIMPI_SUM:
-                first[i] = first[i] + second[i];
-                break;
-            case MIMPI_PROD:
-                first[i] = first[i] * second[i];
-                break;
+    while (i + LZ_MIN_MATCH <= size) {
+        u_int32_t v = lz_read32(in + i);
+        int h = lz_hash(v);
+        int candidate = table[h];
+
+        table[h] = i;
+        if (candidate < 0 || i - candidate > LZ_MAX_OFFSET || lz_read32(in + candidate) != v) {
+            i += 1 + ((i - anchor) >> 6);
+            continue;
         }
-    }
-}
 
-static void send_waiting(int dest, int recv, int sent) {
-    if (g_deadlock_detection) {
-        metadata_t mt;
-        mt.signal = WAITING;
-        mt.tag = 0; // Initializing the data to avoid valgrind errors.
-        mt.count = 0; // Initializing the data to avoid valgrind errors.
-        mt.num_recv = recv;
-        mt.num_sent = sent;
+        int len = LZ_MIN_MATCH;
+        while (i + len < size && in[candidate + len] == in[i + len]) len++;
 
-        thorough_write(mt, NULL,0,
-                       MIMPI_WRITE_OFFSET + MIMPI_MAX_N * MIMPI_World_rank() + dest,
-                       dest);
+        pos = lz_put_sequence(pos, end, in + anchor, i - anchor, i - candidate, len);
+        if (pos == NULL) return -1;
+        i += len;
+        anchor = i;
     }
-}
 
-// Never to be performed outside a mutex!!!
-static bool find_and_delete(
-        void* data,
-        int count,
-        int source,
-        int tag
-) {
-    buffer_node_t* itr = g_first_node;
-    itr = itr->next;
-    while (itr != g_last_node) {
-        if (tag_compare(tag, itr->tag) &&
-        count == itr->count &&
-        source == itr->sender) {
-            memcpy(data, itr->data, count);
-            del_node(itr);
-            return true;
-        }
-        itr = itr->next;
-    }
-    return false;
+    pos = lz_put_sequence(pos, end, in + anchor, size - anchor, 0, 0);
+    return (pos == NULL) ? -1 : pos - out;
 }
 
-static void* helper_main(void* data) {
-    int* dummy = data;
-    const int src = *dummy;
-    free(dummy);
-    const int rank = MIMPI_World_rank();
-    metadata_t mt;
-    int8_t read_buff[MIMPI_READ_BUFFER_SIZE];
-    int offset = 0;
-    int fillup = 0;
+static bool lz_get_length(const u_int8_t** in, const u_int8_t* end, int* len) {
+    u_int8_t b;
 
-    while (true) {
-        if (!thorough_read(read_buff, &offset, &fillup,
-                           &mt, sizeof(metadata_t),
-                           MIMPI_READ_OFFSET + MIMPI_MAX_N * src + rank)) {
+    do {
+        if (*in >= end) return false;
+        b = *(*in)++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
 
-            ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+// Returns false unless the data decompresses to exactly size bytes.
+static bool lz_decompress(const u_int8_t* in, int in_size, u_int8_t* out, int size) {
+    const u_int8_t* end = in + in_size;
+    int pos = 0;
 
-            g_alive[src] = false;
-            ASSERT_SYS_OK(close(MIMPI_READ_OFFSET + MIMPI_MAX_N * src + rank));
+    while (in < end) {
+        int token = *in++;
+        int num_literals = token >> 4;
+        int len = token & 15;
 
-            if (g_alive[rank]) { ASSERT_SYS_OK(close(MIMPI_WRITE_OFFSET + MIMPI_MAX_N * rank + src)); }
+        if (num_literals == 15 && !lz_get_length(&in, end, &num_literals)) return false;
+        if (end - in < num_literals || size - pos < num_literals) return false;
+        memcpy(out + pos, in, num_literals);
+        in += num_literals;
+        pos += num_literals;
 
-            if (g_source == src) {
-                g_recv_sig = PROCESS_ENDED;
+        if (in == end) break;
 
-                ASSERT_SYS_OK(pthread_mutex_unlock(&g_on_recv));
-            } else { ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex)); }
-            break;
+        if (end - in < 2) return false;
+        int offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (len == 15 && !lz_get_length(&in, end, &len)) return false;
+        len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > pos || size - pos < len) return false;
+
+        for (int k = 0; k < len; k++, pos++) { // Byte by byte, since the match may overlap itself.
+            out[pos] = out[pos - offset];
         }
+    }
+    return pos == size;
+}
 
-        void* buff;
+// The io_uring transport, enabled with MIMPI_URING=1. Writes of several frames, to several processes
+// or lanes, are submitted at once and complete in parallel, straight from the buffers of the caller,
+// with descriptors of the channels as fixed files and small frames in the registered g_write_buf.
+// It is set up with plain syscalls, with no library, and where it is not available, like on old kernels
+// or with io_uring disabled, threads write with syscalls as if it had not been asked for.
+// Every write books its time on the emulated network with chbook and is submitted once it is up,
+// so that it takes as long as with chsend.
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
 
-        switch(mt.signal) {
-            case SEND:
-                buff = malloc(mt.count);
-                thorough_read(read_buff, &offset,
-                              &fillup, buff, mt.count,
-                              MIMPI_READ_OFFSET + MIMPI_MAX_N * src + rank);
+static int uring_register(int fd, unsigned opcode, const void* arg, unsigned num_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, num_args);
+}
 
-                buffer_node_t* node = new_node(mt.tag, src, mt.count, buff);
+static void uring_destroy(uring_t* ring) {
+    if (ring->sqes != MAP_FAILED) { ASSERT_SYS_OK(munmap(ring->sqes, ring->sqes_size)); }
+    if (ring->queues != MAP_FAILED) { ASSERT_SYS_OK(munmap(ring->queues, ring->queues_size)); }
+    ASSERT_SYS_OK(close(ring->fd));
+    free(ring);
+}
 
-                ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+// Returns NULL if io_uring cannot be used, for any reason.
+static uring_t* uring_create() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
 
-                g_num_recv[src]++;
+    int fd = (int) syscall(__NR_io_uring_setup, MIMPI_URING_ENTRIES, &params);
+    if (fd == -1) return NULL;
 
-                g_last_node->prev->next = node;
-                node->prev = g_last_node->prev;
-                g_last_node->prev = node;
-                node->next = g_last_node;
+    uring_t* ring = malloc(sizeof(uring_t));
+    ring->fd = fd;
+    ring->queues = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+    memset(ring->fixed, 0, sizeof(ring->fixed));
 
-                if (g_source == src &&
-                    tag_compare(g_tag, mt.tag) &&
-                    g_count == mt.count) {
-                    g_recv_sig = MESSAGE_ARRIVED;
-                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_on_recv));
-                }
-                else if (g_deadlock_detection && g_source == src) {
-                    if (g_is_waiting_on_recv[src] && g_num_sent_to_me[src] == g_num_recv[src]) { // Deadlock.
-                        g_recv_sig = DEADLOCK_DETECTED_BY_ONE_SIDE;
-                        ASSERT_SYS_OK(pthread_mutex_unlock(&g_on_recv));
-                    }
-                    else if (!(g_is_waiting_on_recv[src] && g_num_sent_to_me[src] != g_num_recv[src])) {
-                        g_recv_sig = RETRY_SENDING_WAITING;
-                        ASSERT_SYS_OK(pthread_mutex_unlock(&g_on_recv));
-                    }
-                    else { ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex)); }
-                }
-                else { ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex)); }
-                break;
-            case WAITING: // For deadlock detection.
-                ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+    // Completions must never be dropped, and both queues have to come in one mapping.
+    if (!(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        uring_destroy(ring);
+        return NULL;
+    }
 
-                if (g_source == src &&
-                    g_num_sent[src] == mt.num_recv &&
-                    g_num_recv[src] == mt.num_sent) { // There is a deadlock.
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->queues_size = (sq_size > cq_size) ? sq_size : cq_size;
+    ring->queues = mmap(NULL, ring->queues_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQES);
+    if (ring->queues == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        uring_destroy(ring);
+        return NULL;
+    }
 
-                    g_recv_sig = DEADLOCK_DETECTED_BY_BOTH_SIDES;
+    u_int8_t* queues = ring->queues;
+    ring->sq_head = (atomic_uint*) (queues + params.sq_off.head);
+    ring->sq_tail = (atomic_uint*) (queues + params.sq_off.tail);
+    ring->sq_mask = (unsigned*) (queues + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (queues + params.sq_off.array);
+    ring->cq_head = (atomic_uint*) (queues + params.cq_off.head);
+    ring->cq_tail = (atomic_uint*) (queues + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (queues + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (queues + params.cq_off.cqes);
 
-                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_on_recv));
-                }
-                else if (g_num_sent[src] == mt.num_recv) { // src got all my messages.
-                    g_is_waiting_on_recv[src] = true;
-                    g_num_sent_to_me[src] = mt.num_sent;
+    // The table of fixed files starts empty, descriptors get in on their first write, see uring_fixed_file.
+    struct iovec buffer = {g_write_buf, MIMPI_WRITE_BUFFER_SIZE};
+    int files[MIMPI_SCRATCH_FD_MIN];
+    for (int i = 0; i < MIMPI_SCRATCH_FD_MIN; i++) {
+        files[i] = -1;
+    }
+    if (uring_register(fd, IORING_REGISTER_BUFFERS, &buffer, 1) == -1 ||
+        uring_register(fd, IORING_REGISTER_FILES, files, MIMPI_SCRATCH_FD_MIN) == -1) {
+        uring_destroy(ring);
+        return NULL;
+    }
 
-                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
-                }
-                else { ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex)); }
-                break;
+    bool registered = false;
+    ASSERT_ZERO(pthread_mutex_lock(&g_urings_mutex));
+    for (int i = 0; i < MIMPI_MAX_URINGS && !registered; i++) {
+        if (g_urings[i] == NULL) {
+            g_urings[i] = ring;
+            registered = true;
         }
     }
-    return NULL;
+    ASSERT_ZERO(pthread_mutex_unlock(&g_urings_mutex));
+
+    if (!registered) {
+        uring_destroy(ring);
+        return NULL;
+    }
+    return ring;
 }
 
-/* Library Function */
-void MIMPI_Init(bool enable_deadlock_detection) {
-    channels_init();
+// Returns the ring of the thread, set up on its first use, or NULL if the thread writes with syscalls.
+static uring_t* uring_get() {
+    if (!g_uring_enabled) return NULL;
 
-    ASSERT_ZERO(pthread_mutex_init(&g_mutex, NULL));
-    ASSERT_ZERO(pthread_mutex_init(&g_on_recv, NULL));
-    ASSERT_SYS_OK(pthread_mutex_lock(&g_on_recv)); // This mutex is initialized with 0.
-    g_source = -1;
-    g_deadlock_detection = enable_deadlock_detection;
-    g_first_node = new_node(0, -1, 0, NULL);
-    g_last_node = new_node(0, -1, 0, NULL);
-    g_first_node->next = g_last_node;
-    g_last_node->prev = g_first_node;
-    for (int i = 0; i < MIMPI_World_size(); i++) {
-        g_alive[i] = true;
-        g_is_waiting_on_recv[i] = false;
-        g_num_sent[i] = 0;
-        g_num_recv[i] = 0;
+    if (!g_uring_tried) {
+        g_uring_tried = true;
+        g_uring = uring_create();
     }
+    return g_uring;
+}
 
-    for (int i = 0; i < MIMPI_World_size(); i++) {
-        if (i != MIMPI_World_rank()) {
-            int* thread_data = malloc(sizeof(int));
-            *thread_data = i;
-            ASSERT_ZERO(pthread_create(&thread[i], NULL, helper_main, thread_data));
-        }
+// To be performed by every thread which may have a ring before it ends.
+static void uring_release() {
+    if (g_uring == NULL) return;
+
+    ASSERT_ZERO(pthread_mutex_lock(&g_urings_mutex));
+    for (int i = 0; i < MIMPI_MAX_URINGS; i++) {
+        if (g_urings[i] == g_uring) g_urings[i] = NULL;
     }
+    ASSERT_ZERO(pthread_mutex_unlock(&g_urings_mutex));
+
+    uring_destroy(g_uring);
+    g_uring = NULL;
+    g_uring_tried = false;
 }
 
-void MIMPI_Finalize() {
-    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+// Puts the descriptor in the table of fixed files at its own number. Returns the number or -1 if it fails.
+static int uring_fixed_file(uring_t* ring, int fd) {
+    int ret = fd;
 
-    g_alive[MIMPI_World_rank()] = false;
-    for (int i = 0; i < MIMPI_World_size(); i++) {
-        if (g_alive[i]) {
-            ASSERT_SYS_OK(close(MIMPI_WRITE_OFFSET + MIMPI_MAX_N * MIMPI_World_rank() + i));
-        }
+    ASSERT_ZERO(pthread_mutex_lock(&g_urings_mutex));
+    if (!ring->fixed[fd]) {
+        struct io_uring_files_update update = {.offset = fd, .fds = (u_int64_t) (uintptr_t) &fd};
+
+        if (uring_register(ring->fd, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1) ring->fixed[fd] = true;
+        else ret = -1;
     }
-    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    ASSERT_ZERO(pthread_mutex_unlock(&g_urings_mutex));
+    return ret;
+}
+
+// Takes the descriptor out of the tables of all rings, which would keep the channel open otherwise.
+// To be performed before closing a write descriptor.
+static void uring_forget(int fd) {
+    int none = -1;
+    struct io_uring_files_update update = {.offset = fd, .fds = (u_int64_t) (uintptr_t) &none};
 
-    for (int i = 0; i < MIMPI_World_size(); i++) {
-        if (i != MIMPI_World_rank()) {
-            ASSERT_ZERO(pthread_join(thread[i], NULL));
+    ASSERT_ZERO(pthread_mutex_lock(&g_urings_mutex));
+    for (int i = 0; i < MIMPI_MAX_URINGS; i++) {
+        if (g_urings[i] != NULL && g_urings[i]->fixed[fd]) {
+            ASSERT_SYS_OK(uring_register(g_urings[i]->fd, IORING_REGISTER_FILES_UPDATE, &update, 1));
+            g_urings[i]->fixed[fd] = false;
         }
     }
-
-    cleanup();
-    channels_finalize();
+    ASSERT_ZERO(pthread_mutex_unlock(&g_urings_mutex));
 }
 
-int MIMPI_World_size() {
-    return atoi(getenv("MIMPI_size"));
+// Queues a write of what is left of a frame, as iov, tagged with the index of the frame.
+static void uring_queue_write(uring_t* ring, const frame_t* frame, struct iovec* iov, int iovcnt, int index) {
+    unsigned tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    unsigned slot = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[slot];
+    int fixed_fd = uring_fixed_file(ring, frame->fd);
+    u_int8_t* base = iov[0].iov_base;
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (iovcnt == 1 && base >= g_write_buf && base < g_write_buf + MIMPI_WRITE_BUFFER_SIZE) {
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->addr = (u_int64_t) (uintptr_t) base;
+        sqe->len = iov[0].iov_len;
+        sqe->buf_index = 0;
+    } else {
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->addr = (u_int64_t) (uintptr_t) iov;
+        sqe->len = iovcnt;
+    }
+    if (fixed_fd != -1) {
+        sqe->fd = fixed_fd;
+        sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = frame->fd;
+    }
+    sqe->user_data = index;
+
+    ring->sq_array[slot] = slot;
+    atomic_store_explicit(ring->sq_tail, tail + 1, memory_order_release);
 }
 
-int MIMPI_World_rank() {
-    return atoi(getenv("MIMPI_rank"));
+// Submits the queued writes and waits for min_complete of them to complete.
+static void uring_submit(uring_t* ring, unsigned min_complete) {
+    int ret;
+
+    do {
+        unsigned to_submit = atomic_load_explicit(ring->sq_tail, memory_order_relaxed) -
+                             atomic_load_explicit(ring->sq_head, memory_order_acquire);
+        ret = uring_enter(ring->fd, to_submit, min_complete, (min_complete > 0) ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret == -1 && errno == EINTR);
+    ASSERT_SYS_OK(ret);
 }
 
-MIMPI_Retcode MIMPI_Send(
-        void const* data,
-        int count,
-        int destination,
-        int tag
-) {
-    int rank = MIMPI_World_rank();
+// Writes the prepared frames, in one batch, each of them whole. Sets ret of every one of them.
+static void uring_write(uring_t* ring, frame_t* frames, int num) {
+    struct iovec iovs[MIMPI_URING_ENTRIES][2];
+    int first[MIMPI_URING_ENTRIES]; // The first iov of the frame with bytes left to write.
+    bool busy[MIMPI_URING_ENTRIES];
+    int left = num;
 
-    if (destination == rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
-    if (destination < 0 || destination >= MIMPI_World_size()) return MIMPI_ERROR_NO_SUCH_RANK;
-    if (!g_alive[destination]) return MIMPI_ERROR_REMOTE_FINISHED;
+    assert(num <= MIMPI_URING_ENTRIES);
 
-    metadata_t mt;
-    mt.signal = SEND;
-    mt.tag = tag;
-    mt.count = count;
-    mt.num_recv = 0; // Initializing the data to avoid valgrind errors.
-    mt.num_sent = 0; // Initializing the data to avoid valgrind errors.
+    // The metadata, and the data too if there is room, go in the registered buffer.
+    for (int i = 0; i < num; i++) {
+        u_int8_t* slot = g_write_buf + i * MIMPI_URING_SLOT;
 
+        memcpy(slot, &frames[i].mt, sizeof(metadata_t));
+        iovs[i][0] = (struct iovec) {slot, sizeof(metadata_t)};
+        iovs[i][1] = (struct iovec) {(void*) frames[i].data, frames[i].size};
+        if (sizeof(metadata_t) + frames[i].size <= MIMPI_URING_SLOT) {
+            if (frames[i].size > 0) { memcpy(slot + sizeof(metadata_t), frames[i].data, frames[i].size); }
+            iovs[i][0].iov_len += frames[i].size;
+            iovs[i][1].iov_len = 0;
+        }
+        first[i] = 0;
+        busy[i] = false;
+        frames[i].ret = true;
+    }
+
+    // Frames go out in the order they reach the other end, each on its own link, so frames
+    // whose time is up are submitted before waiting for the next one.
+    long long arrivals[MIMPI_URING_ENTRIES];
+    int order[MIMPI_URING_ENTRIES];
+    for (int i = 0; i < num; i++) {
+        int j = i;
+
+        arrivals[i] = chbook(frames[i].fd, iovs[i][0].iov_len + iovs[i][1].iov_len);
+        while (j > 0 && arrivals[order[j - 1]] > arrivals[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    for (int k = 0; k < num; k++) {
+        int i = order[k];
+        int iovcnt = (iovs[i][1].iov_len > 0) ? 2 : 1;
+
+        if (arrivals[i] > 0) {
+            uring_submit(ring, 0);
+            chwait(arrivals[i]);
+        }
+        uring_queue_write(ring, &frames[i], iovs[i], iovcnt, i);
+        busy[i] = true;
+    }
+
+    while (left > 0) {
+        for (int i = 0; i < num; i++) {
+            if (busy[i] || first[i] == 2) continue;
+            int iovcnt = (first[i] == 0 && iovs[i][1].iov_len > 0) ? 2 : 1;
+            uring_queue_write(ring, &frames[i], &iovs[i][first[i]], iovcnt, i);
+            busy[i] = true;
+        }
+
+        uring_submit(ring, 1);
+
+        unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+
+        for (; head != tail; head++) {
+            const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            int i = (int) cqe->user_data;
+            size_t written = (cqe->res > 0) ? cqe->res : 0;
+
+            busy[i] = false;
+            if (cqe->res == -EAGAIN || cqe->res == -EINTR) continue;
+            if (cqe->res < 0) {
+                if (g_alive[frames[i].dest]) {
+                    errno = -cqe->res;
+                    syserr("io_uring write to %d failed", frames[i].dest);
+                }
+                frames[i].ret = false;
+                first[i] = 2;
+                left--;
+                continue;
+            }
+
+            // Writes to pipes may be short, the rest goes in the next round.
+            while (first[i] < 2 && written >= iovs[i][first[i]].iov_len) {
+                written -= iovs[i][first[i]].iov_len;
+                first[i]++;
+            }
+            if (first[i] < 2) {
+                iovs[i][first[i]].iov_base = (u_int8_t*) iovs[i][first[i]].iov_base + written;
+                iovs[i][first[i]].iov_len -= written;
+            }
+            if (first[i] == 1 && iovs[i][1].iov_len == 0) first[i] = 2;
+            if (first[i] == 2) left--;
+        }
+        atomic_store_explicit(ring->cq_head, head, memory_order_release);
+    }
+}
+
+// Data of at least g_compress_threshold bytes goes compressed if that makes it smaller.
+static void frame_prepare(frame_t* frame) {
+    frame->mt.compressed = false;
+    frame->mt.frame_size = frame->size;
+    frame->compressed = NULL;
+
+    if (g_compress_threshold > 0 && frame->size >= g_compress_threshold) {
+        frame->compressed = malloc(frame->size);
+        int size = lz_compress(frame->data, frame->size, frame->compressed, frame->size - 1);
+
+        atomic_fetch_add(&g_compress_raw, frame->size);
+        if (size > 0) {
+            frame->mt.compressed = true;
+            frame->mt.frame_size = size;
+            frame->data = frame->compressed;
+            frame->size = size;
+        }
+        atomic_fetch_add(&g_compress_sent, frame->size);
+    }
+}
+
+// Writes the frames, through the ring of the thread in one batch if it has one,
+// otherwise one after another. Returns false in case no read descriptor for any of the channels is open.
+static bool write_frames(frame_t* frames, int num) {
+    uring_t* ring = uring_get();
+    bool ret = true;
+
+    for (int i = 0; i < num; i++) {
+        frame_prepare(&frames[i]);
+    }
+
+    if (ring != NULL) {
+        uring_write(ring, frames, num);
+    } else {
+        for (int i = 0; i < num; i++) {
+            frames[i].ret = write_frame(frames[i].mt, frames[i].data, frames[i].size, frames[i].fd, frames[i].dest);
+        }
+    }
+
+    for (int i = 0; i < num; i++) {
+        free(frames[i].compressed);
+        ret &= frames[i].ret;
+    }
+    return ret;
+}
+
+// Tries to write the metadata and data of count bytes and no less.
+// Returns false in case no read descriptor for the channel is open.
+static bool thorough_write(metadata_t mt, const void* data, int count, int fd, int dest) {
+    frame_t frame = {mt, data, count, fd, dest, NULL, false};
+    return write_frames(&frame, 1);
+}
+
+// Reads the data following the metadata into buff, which has room for the size bytes it stands for.
+static void read_payload(void* read_buf, int* offset, int* fillup, const metadata_t* mt, void* buff, int size, int fd) {
+    if (!mt->compressed) {
+        thorough_read(read_buf, offset, fillup, buff, size, fd);
+        return;
+    }
+
+    u_int8_t* frame = malloc(mt->frame_size);
+    thorough_read(read_buf, offset, fillup, frame, mt->frame_size, fd);
+    if (!lz_decompress(frame, mt->frame_size, buff, size)) fatal("Corrupted compressed message");
+    free(frame);
+}
+
+// Writes with syscalls, the stripe writers are too short-lived for rings of their own.
+static void* stripe_writer_main(void* data) {
+    frame_t* frame = data;
+
+    frame_prepare(frame);
+    frame->ret = write_frame(frame->mt, frame->data, frame->size, frame->fd, frame->dest);
+    free(frame->compressed);
+    return NULL;
+}
+
+// Splits a big message into a stripe per data lane, each with a copy of the metadata, written
+// at the same time in one batch of io_uring or by threads of their own. With every data lane locked
+// for the whole message, stripes of different messages reach all lanes in the same order.
+// Returns false in case no read descriptor for any of the channels is open.
+static bool send_striped(metadata_t mt, const void* data, int count, int dest) {
+    frame_t frames[MIMPI_MAX_STRIPES];
+    pthread_t writers[MIMPI_MAX_STRIPES];
+    int offset;
+    int size;
+    bool ret;
+
+    mt.stripes = g_num_stripes;
+    for (int stripe = 0; stripe < g_num_stripes; stripe++) {
+        ASSERT_ZERO(pthread_mutex_lock(&g_write_mutex[dest][stripe_lane(stripe)]));
+
+        stripe_part(count, g_num_stripes, stripe, &offset, &size);
+        frames[stripe] = (frame_t) {mt, (const u_int8_t*) data + offset, size,
+                                    write_fd(dest, stripe_lane(stripe)), dest, NULL, false};
+    }
+
+    if (uring_get() != NULL) {
+        ret = write_frames(frames, g_num_stripes);
+    } else {
+        for (int stripe = 1; stripe < g_num_stripes; stripe++) {
+            ASSERT_ZERO(pthread_create(&writers[stripe], NULL, stripe_writer_main, &frames[stripe]));
+        }
+
+        ret = write_frames(frames, 1);
+
+        for (int stripe = 1; stripe < g_num_stripes; stripe++) {
+            ASSERT_ZERO(pthread_join(writers[stripe], NULL));
+            ret &= frames[stripe].ret;
+        }
+    }
+
+    for (int stripe = g_num_stripes - 1; stripe >= 0; stripe--) {
+        ASSERT_ZERO(pthread_mutex_unlock(&g_write_mutex[dest][stripe_lane(stripe)]));
+    }
+    return ret;
+}
+
+// Never to be performed on g_first_node or g_last_node!!!
+static void unlink_node(buffer_node_t* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+}
+
+static void free_node(buffer_node_t* node) {
+    free(node->data);
+    free(node);
+}
+
+static inline int left_child(int rank) { return rank * 2 + 1; }
+
+static inline int right_child(int rank) { return left_child(rank) + 1; }
+
+static inline int parent(int rank) {
+    return (rank - 1) / 2;
+}
+
+static inline bool is_root(int rank) {
+    return rank == 0;
+}
+
+static int rank_adjust(int og_rank, int root) {
+    if (og_rank == root) return 0;
+    else if (og_rank == 0) return root;
+    else return og_rank;
+}
+
+static void build_binary_tree(tree_links_t* links, int og_rank, int size, int root) {
+    int rank = rank_adjust(og_rank, root);
+
+    links->parent = is_root(rank) ? -1 : rank_adjust(parent(rank), root);
+    links->num_children = 0;
+
+    if (left_child(rank) < size) {
+        links->children[links->num_children++] = rank_adjust(left_child(rank), root);
+    }
+
+    if (right_child(rank) < size) {
+        links->children[links->num_children++] = rank_adjust(right_child(rank), root);
+    }
+}
+
+// In the binomial tree the parent of a process is obtained by clearing
+// the lowest set bit of its distance from the root.
+static void build_binomial_tree(tree_links_t* links, int og_rank, int size, int root) {
+    int rank = (og_rank - root + size) % size;
+    int mask = 1;
+
+    while (mask < size && !(rank & mask)) mask <<= 1;
+
+    links->parent = is_root(rank) ? -1 : (rank - mask + root) % size;
+    links->num_children = 0;
+
+    for (mask >>= 1; mask > 0; mask >>= 1) {
+        if (rank + mask < size) {
+            links->children[links->num_children++] = (rank + mask + root) % size;
+        }
+    }
+}
+
+static void build_chain(tree_links_t* links, int og_rank, int size, int root) {
+    int rank = (og_rank - root + size) % size;
+
+    links->parent = is_root(rank) ? -1 : (og_rank - 1 + size) % size;
+    links->num_children = 0;
+
+    if (rank + 1 < size) {
+        links->children[links->num_children++] = (og_rank + 1) % size;
+    }
+}
+
+static void comm_setup(comm_t* comm, int context, int rank, int size, const int* world_ranks, bool synchronizing) {
+    comm->used = true;
+    comm->context = context;
+    comm->rank = rank;
+    comm->size = size;
+    comm->synchronizing = synchronizing;
+    comm->num_requests = 0;
+    comm->has_topology = false;
+    memcpy(comm->world_ranks, world_ranks, size * sizeof(int));
+    for (int root = 0; root < size; root++) {
+        build_binary_tree(&comm->trees[TREE_BINARY][root], rank, size, root);
+        build_binomial_tree(&comm->trees[TREE_BINOMIAL][root], rank, size, root);
+        build_chain(&comm->trees[TREE_CHAIN][root], rank, size, root);
+    }
+}
+
+// Returns NULL if the handle does not refer to a communicator of this process.
+static comm_t* comm_get(MIMPI_Comm handle) {
+    if (handle < 0 || handle >= MIMPI_MAX_COMMS || !g_comms[handle].used) return NULL;
+    return &g_comms[handle];
+}
+
+static inline int maximum(int a, int b) {
+    return (a > b) ? a : b;
+}
+
+// Returns NULL for built-in operations and handles not referring to any operation.
+static const user_op_t* user_op_get(MIMPI_Op op) {
+    int idx = (int) op - MIMPI_OP_USER_FIRST;
+
+    if (idx < 0 || idx >= MIMPI_MAX_USER_OPS || !g_ops[idx].used) return NULL;
+    return &g_ops[idx];
+}
+
+static bool op_valid(MIMPI_Op op) {
+    return ((int) op >= MIMPI_MAX && (int) op <= MIMPI_PROD) || user_op_get(op) != NULL;
+}
+
+static int op_elem_size(MIMPI_Op op) {
+    const user_op_t* user_op = user_op_get(op);
+    return user_op ? user_op->elem_size : 1;
+}
+
+static bool op_commutative(MIMPI_Op op) {
+    const user_op_t* user_op = user_op_get(op);
+    return user_op ? user_op->commutative : true;
+}
+
+// The largest multiple of elem_size not exceeding size (but at least a single element).
+static int round_to_elems(int size, int elem_size) {
+    return maximum(elem_size, size - size % elem_size);
+}
+
+// Combines second into first, i.e. first = first op second, element by element.
+// Built-in operations are chosen outside of the loops, so that the compiler can vectorise them.
+static void reduction(u_int8_t* first, const u_int8_t* second, int size, MIMPI_Op op) {
+    const user_op_t* user_op = user_op_get(op);
+
+    if (user_op) {
+        user_op->fn(second, first, size / user_op->elem_size);
+        return;
+    }
+
+    switch (op) {
+        case MIMPI_MAX:
+            for (int i = 0; i < size; i++) {
+                if(first[i] < second[i]) first[i] = second[i];
+            }
+            break;
+        case MIMPI_MIN:
+            for (int i = 0; i < size; i++) {
+                if(first[i] > second[i]) first[i] = second[i];
+            }
+            break;
+        case MIMPI_SUM:
+            for (int i = 0; i < size; i++) {
+                first[i] = first[i] + second[i];
+            }
+            break;
+        case MIMPI_PROD:
+            for (int i = 0; i < size; i++) {
+                first[i] = first[i] * second[i];
+            }
+            break;
+        default: // Invalid operations never get here.
+            break;
+    }
+}
+
+/* Reduction Pool */
+// Takes the next chunk of the current job, if there is one left. Never to be performed outside g_pool_mutex!!!
+static bool reduction_chunk_take(int* chunk) {
+    if (!g_job.active || g_job.next_chunk == g_job.num_chunks) return false;
+    *chunk = g_job.next_chunk++;
+    return true;
+}
+
+// Never to be performed inside g_pool_mutex!!!
+static void reduction_chunk_run(int chunk) {
+    int offset = chunk * g_job.chunk_size;
+    int size = minimum(g_job.chunk_size, g_job.size - offset);
+
+    reduction(g_job.first + offset, g_job.second + offset, size, g_job.op);
+
+    ASSERT_ZERO(pthread_mutex_lock(&g_pool_mutex));
+    if (++g_job.chunks_done == g_job.num_chunks) { ASSERT_ZERO(pthread_cond_signal(&g_pool_done)); }
+    ASSERT_ZERO(pthread_mutex_unlock(&g_pool_mutex));
+}
+
+static void* reducer_main(void* data) {
+    int chunk;
+
+    while (true) {
+        ASSERT_ZERO(pthread_mutex_lock(&g_pool_mutex));
+        while (!g_pool_exit && !reduction_chunk_take(&chunk)) {
+            ASSERT_ZERO(pthread_cond_wait(&g_pool_work, &g_pool_mutex));
+        }
+        if (g_pool_exit) {
+            ASSERT_ZERO(pthread_mutex_unlock(&g_pool_mutex));
+            return NULL;
+        }
+        ASSERT_ZERO(pthread_mutex_unlock(&g_pool_mutex));
+
+        reduction_chunk_run(chunk);
+    }
+}
+
+static void reduction_pool_init() {
+    const char* threads_str = getenv("MIMPI_REDUCTION_THREADS");
+
+    g_num_reducers = threads_str ? atoi(threads_str) : 0;
+    if (g_num_reducers < 0) g_num_reducers = 0;
+    if (g_num_reducers > MIMPI_MAX_REDUCTION_THREADS) g_num_reducers = MIMPI_MAX_REDUCTION_THREADS;
+
+    g_job.active = false;
+    g_pool_exit = false;
+    atomic_init(&g_pool_bytes, 0);
+    ASSERT_ZERO(pthread_mutex_init(&g_pool_mutex, NULL));
+    ASSERT_ZERO(pthread_cond_init(&g_pool_work, NULL));
+    ASSERT_ZERO(pthread_cond_init(&g_pool_done, NULL));
+
+    for (int i = 0; i < g_num_reducers; i++) {
+        ASSERT_ZERO(pthread_create(&g_reducers[i], NULL, reducer_main, NULL));
+    }
+}
+
+static void reduction_pool_finalize() {
+    ASSERT_ZERO(pthread_mutex_lock(&g_pool_mutex));
+    g_pool_exit = true;
+    ASSERT_ZERO(pthread_cond_broadcast(&g_pool_work));
+    ASSERT_ZERO(pthread_mutex_unlock(&g_pool_mutex));
+
+    for (int i = 0; i < g_num_reducers; i++) {
+        ASSERT_ZERO(pthread_join(g_reducers[i], NULL));
+    }
+
+    ASSERT_ZERO(pthread_mutex_destroy(&g_pool_mutex));
+    ASSERT_ZERO(pthread_cond_destroy(&g_pool_work));
+    ASSERT_ZERO(pthread_cond_destroy(&g_pool_done));
+}
+
+// Starts combining second into first. Large combines are split into cache-sized chunks
+// and handed to the pool, so the caller can wait for the next message in the meantime;
+// small ones are performed right away. Must be followed by reduction_wait().
+static void reduction_start(u_int8_t* first, const u_int8_t* second, int size, MIMPI_Op op) {
+    if (g_num_reducers == 0 || size < MIMPI_PARALLEL_REDUCTION_MIN) {
+        reduction(first, second, size, op);
+        return;
+    }
+
+    atomic_fetch_add(&g_pool_bytes, size);
+    ASSERT_ZERO(pthread_mutex_lock(&g_pool_mutex));
+    g_job.first = first;
+    g_job.second = second;
+    g_job.size = size;
+    g_job.op = op;
+    g_job.chunk_size = round_to_elems(MIMPI_REDUCTION_CHUNK, op_elem_size(op));
+    g_job.next_chunk = 0;
+    g_job.num_chunks = (size + g_job.chunk_size - 1) / g_job.chunk_size;
+    g_job.chunks_done = 0;
+    g_job.active = true;
+    ASSERT_ZERO(pthread_cond_broadcast(&g_pool_work));
+    ASSERT_ZERO(pthread_mutex_unlock(&g_pool_mutex));
+}
+
+// Helps the pool with the chunks left and waits until the combine started last is done.
+static void reduction_wait() {
+    int chunk;
+
+    ASSERT_ZERO(pthread_mutex_lock(&g_pool_mutex));
+    if (!g_job.active) {
+        ASSERT_ZERO(pthread_mutex_unlock(&g_pool_mutex));
+        return;
+    }
+
+    while (reduction_chunk_take(&chunk)) {
+        ASSERT_ZERO(pthread_mutex_unlock(&g_pool_mutex));
+        reduction_chunk_run(chunk);
+        ASSERT_ZERO(pthread_mutex_lock(&g_pool_mutex));
+    }
+
+    while (g_job.chunks_done < g_job.num_chunks) {
+        ASSERT_ZERO(pthread_cond_wait(&g_pool_done, &g_pool_mutex));
+    }
+    g_job.active = false;
+    ASSERT_ZERO(pthread_mutex_unlock(&g_pool_mutex));
+}
+
+static void send_waiting(int dest, int recv, int sent) {
+    if (g_deadlock_detection) {
+        metadata_t mt;
+        mt.signal = WAITING;
+        mt.context = 0; // Initializing the data to avoid valgrind errors.
+        mt.tag = 0; // Initializing the data to avoid valgrind errors.
+        mt.count = 0; // Initializing the data to avoid valgrind errors.
+        mt.num_recv = recv;
+        mt.num_sent = sent;
+        mt.stripes = 1;
+
+        ASSERT_ZERO(pthread_mutex_lock(&g_write_mutex[dest][LANE_CONTROL]));
+        thorough_write(mt, NULL, 0, write_fd(dest, LANE_CONTROL), dest);
+        ASSERT_ZERO(pthread_mutex_unlock(&g_write_mutex[dest][LANE_CONTROL]));
+    }
+}
+
+// Never to be performed outside a mutex!!!
+static buffer_node_t* find_and_unlink(
+        int count,
+        int source,
+        int tag,
+        int context
+) {
+    buffer_node_t* itr = g_first_node;
+    itr = itr->next;
+    while (itr != g_last_node) {
+        if (context == itr->context &&
+        tag_compare(tag, itr->tag) &&
+        count == itr->count &&
+        source == itr->sender) {
+            unlink_node(itr);
+            return itr;
+        }
+        itr = itr->next;
+    }
+    return NULL;
+}
+
+static void delivery_queue_init(delivery_queue_t* queue) {
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->num_overflowing, 0);
+    ASSERT_ZERO(pthread_mutex_init(&queue->overflow_mutex, NULL));
+    queue->overflow_first = NULL;
+    queue->overflow_last = NULL;
+}
+
+// Performed only by the helper of the process owning the queue.
+// Once an event overflows, the following ones do as well until the consumer catches up.
+static void delivery_push(delivery_queue_t* queue, const delivery_t* delivery) {
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (atomic_load(&queue->num_overflowing) == 0 && tail - head < MIMPI_DELIVERY_QUEUE_SIZE) {
+        queue->slots[tail % MIMPI_DELIVERY_QUEUE_SIZE] = *delivery;
+        atomic_store(&queue->tail, tail + 1);
+        return;
+    }
+
+    overflow_node_t* node = malloc(sizeof(overflow_node_t));
+    node->delivery = *delivery;
+    node->next = NULL;
+
+    ASSERT_ZERO(pthread_mutex_lock(&queue->overflow_mutex));
+    if (queue->overflow_last != NULL) { queue->overflow_last->next = node; }
+    else { queue->overflow_first = node; }
+    queue->overflow_last = node;
+    atomic_fetch_add(&queue->num_overflowing, 1);
+    ASSERT_ZERO(pthread_mutex_unlock(&queue->overflow_mutex));
+}
+
+static bool delivery_pending(int src) {
+    for (int lane = 0; lane < g_num_lanes; lane++) {
+        const delivery_queue_t* queue = &g_queues[src][lane];
+        if (atomic_load(&queue->tail) != atomic_load_explicit(&queue->head, memory_order_relaxed) ||
+            atomic_load(&queue->num_overflowing) > 0) return true;
+    }
+    return false;
+}
+
+// Never to be performed outside a mutex!!!
+static void deliver(int src, const delivery_t* delivery) {
+    buffer_node_t* node = delivery->node;
+
+    switch (delivery->kind) {
+        case DELIVERY_MESSAGE:
+            g_num_recv[src]++;
+
+            // The receive is decided, so a WAITING delivered after it in the same batch is about the next one.
+            if (g_source == src && node->context == g_source_context &&
+                tag_compare(g_source_tag, node->tag) && node->count == g_source_count) {
+                g_source = -1;
+            }
+
+            g_last_node->prev->next = node;
+            node->prev = g_last_node->prev;
+            g_last_node->prev = node;
+            node->next = g_last_node;
+            break;
+        case DELIVERY_WAITING:
+            if (g_source == src &&
+                g_num_sent[src] == delivery->num_recv &&
+                g_num_recv[src] == delivery->num_sent) { // There is a deadlock.
+
+                g_deadlock_both = true;
+                g_source = -1; // Like above, a WAITING after this one is about the next receive.
+            }
+            else if (g_num_sent[src] == delivery->num_recv) { // src got all my messages.
+                g_is_waiting_on_recv[src] = true;
+                g_num_sent_to_me[src] = delivery->num_sent;
+            }
+            break;
+        case DELIVERY_END:
+            if (++g_lanes_ended[src] == g_num_lanes) { g_ended[src] = true; }
+            break;
+    }
+    g_num_delivered[src]++;
+}
+
+// Moves the events queued by the helper of a lane to the structures of the receiving side.
+// Messages of a lane may overtake the ones of the other, which matters neither to matching,
+// since only messages of the same size compete for a receive, nor to deadlock detection,
+// which compares counts of messages. Returns whether there were any events.
+// Never to be performed outside a mutex!!!
+static bool deliver_lane(int src, int lane) {
+    delivery_queue_t* queue = &g_queues[src][lane];
+    overflow_node_t* overflow = NULL;
+    bool overflowing = atomic_load(&queue->num_overflowing) > 0;
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned tail;
+
+    // With the overflow list locked the ring cannot get newer events than the ones in the list.
+    if (overflowing) { ASSERT_ZERO(pthread_mutex_lock(&queue->overflow_mutex)); }
+
+    tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail && !overflowing) return false;
+
+    for (; head != tail; head++) {
+        deliver(src, &queue->slots[head % MIMPI_DELIVERY_QUEUE_SIZE]);
+        atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    }
+
+    if (overflowing) {
+        overflow = queue->overflow_first;
+        queue->overflow_first = NULL;
+        queue->overflow_last = NULL;
+        atomic_store(&queue->num_overflowing, 0);
+        ASSERT_ZERO(pthread_mutex_unlock(&queue->overflow_mutex));
+    }
+
+    while (overflow != NULL) {
+        overflow_node_t* next = overflow->next;
+        deliver(src, &overflow->delivery);
+        free(overflow);
+        overflow = next;
+    }
+    return true;
+}
+
+// Never to be performed outside a mutex!!!
+static bool deliver_from(int src) {
+    bool delivered = false;
+
+    delivered |= deliver_lane(src, LANE_CONTROL);
+    for (int lane = 0; lane < g_num_lanes; lane++) {
+        if (lane != LANE_CONTROL) { delivered |= deliver_lane(src, lane); }
+    }
+    if (!delivered) return false;
+
+    // The other consumer may be sleeping for what has just been delivered.
+    if (atomic_load(&g_recv_sleeping) != -1) { ASSERT_ZERO(pthread_cond_signal(&g_on_recv)); }
+    if (atomic_load(&g_progress_sleeping)) { ASSERT_ZERO(pthread_cond_signal(&g_progress)); }
+    return true;
+}
+
+// Never to be performed outside a mutex!!!
+static bool deliver_all() {
+    bool delivered = false;
+
+    for (int i = 0; i < g_size; i++) {
+        if (i != g_rank) { delivered |= deliver_from(i); }
+    }
+    return delivered;
+}
+
+static bool delivery_pending_any() {
+    for (int i = 0; i < g_size; i++) {
+        if (i != g_rank && delivery_pending(i)) return true;
+    }
+    return false;
+}
+
+// Performed by the helper of src after queueing an event. The mutex is taken only when
+// a consumer has gone to sleep, which it does only after seeing the queue empty.
+static void delivery_notify(int src) {
+    if (atomic_load(&g_recv_sleeping) == src || atomic_load(&g_progress_sleeping)) {
+        ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+        ASSERT_ZERO(pthread_cond_signal(&g_on_recv));
+        ASSERT_ZERO(pthread_cond_signal(&g_progress));
+        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    }
+}
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Waits until there are new events from src, either still queued or already delivered
+// by the progress thread. Spins a while first, since small messages often arrive within
+// microseconds. The budget grows when spinning pays off and shrinks when the receive has to
+// sleep anyway. Never to be performed outside a mutex!!!
+static void wait_for_delivery(int src) {
+    int delivered = g_num_delivered[src];
+    int spins = 0;
+
+    if (g_spin_budget > 0) {
+        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+        while (spins < g_spin_budget && !delivery_pending(src)) {
+            cpu_relax();
+            spins++;
+        }
+        ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+    }
+
+    if (delivery_pending(src) || g_num_delivered[src] != delivered) {
+        if (spins > 0) g_spin_budget = minimum(2 * g_spin_budget, g_max_spin);
+        return;
+    }
+
+    g_spin_budget /= 2;
+    if (g_spin_budget == 0 && g_max_spin > 0) g_spin_budget = 1;
+
+    atomic_store(&g_recv_sleeping, src);
+    while (!delivery_pending(src) && g_num_delivered[src] == delivered) {
+        ASSERT_ZERO(pthread_cond_wait(&g_on_recv, &g_mutex));
+    }
+    atomic_store(&g_recv_sleeping, -1);
+}
+
+static void spin_init() {
+    cpu_set_t cpus;
+    const char* spin_str = getenv("MIMPI_SPIN");
+
+    ASSERT_SYS_OK(sched_getaffinity(0, sizeof(cpus), &cpus));
+    g_max_spin = (g_size <= CPU_COUNT(&cpus)) ? MIMPI_MAX_SPIN : 0;
+    if (spin_str) g_max_spin = atoi(spin_str);
+    g_spin_budget = g_max_spin / 4;
+    atomic_init(&g_recv_sleeping, -1);
+    atomic_init(&g_progress_sleeping, false);
+}
+
+// Reads the stripe following the metadata into the message published by the helper of LANE_DATA.
+// Skips it if LANE_DATA has closed without the message, so when the sender has died sending it.
+static void read_stripe(int src, int lane, const metadata_t* mt,
+                        void* read_buf, int* offset, int* fillup, int fd) {
+    reassembly_t* re = &g_reassembly[src];
+    int part_offset;
+    int part_size;
+
+    stripe_part(mt->count, mt->stripes, lane - LANE_STRIPES + 1, &part_offset, &part_size);
+
+    ASSERT_ZERO(pthread_mutex_lock(&re->mutex));
+    while (re->generation == re->num_read[lane] && !re->closed[LANE_DATA]) {
+        ASSERT_ZERO(pthread_cond_wait(&re->cond, &re->mutex));
+    }
+    u_int8_t* buff = (re->generation > re->num_read[lane]) ? re->buff : NULL;
+    ASSERT_ZERO(pthread_mutex_unlock(&re->mutex));
+
+    if (buff == NULL) return;
+    read_payload(read_buf, offset, fillup, mt, buff + part_offset, part_size, fd);
+
+    ASSERT_ZERO(pthread_mutex_lock(&re->mutex));
+    re->num_read[lane]++;
+    ASSERT_ZERO(pthread_cond_broadcast(&re->cond));
+    ASSERT_ZERO(pthread_mutex_unlock(&re->mutex));
+}
+
+// Reads the first stripe of a message into buff, while the helpers of the other stripe lanes read theirs.
+// Returns false if any of them has closed without its stripe, so when the sender has died sending it.
+static bool read_striped(int src, const metadata_t* mt, void* buff,
+                         void* read_buf, int* offset, int* fillup, int fd) {
+    reassembly_t* re = &g_reassembly[src];
+    int part_offset;
+    int part_size;
+    bool complete = true;
+
+    ASSERT_ZERO(pthread_mutex_lock(&re->mutex));
+    re->buff = buff;
+    re->generation++;
+    ASSERT_ZERO(pthread_cond_broadcast(&re->cond));
+    ASSERT_ZERO(pthread_mutex_unlock(&re->mutex));
+
+    stripe_part(mt->count, mt->stripes, 0, &part_offset, &part_size);
+    read_payload(read_buf, offset, fillup, mt, buff, part_size, fd);
+
+    ASSERT_ZERO(pthread_mutex_lock(&re->mutex));
+    for (int stripe = 1; stripe < mt->stripes; stripe++) {
+        int lane = stripe_lane(stripe);
+        while (re->num_read[lane] < re->generation && !re->closed[lane]) {
+            ASSERT_ZERO(pthread_cond_wait(&re->cond, &re->mutex));
+        }
+        complete &= re->num_read[lane] == re->generation;
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&re->mutex));
+    return complete;
+}
+
+// Takes no locks on the way of a message, only to wake a sleeping consumer and once the channel closes.
+// Helpers of stripe lanes only read stripes into messages delivered by the helper of LANE_DATA.
+static void* helper_main(void* data) {
+    int* dummy = data;
+    const int src = *dummy / MIMPI_MAX_LANES;
+    const int lane = *dummy % MIMPI_MAX_LANES;
+    free(dummy);
+    const int rank = g_rank;
+    const int fd = read_fd(src, lane);
+    metadata_t mt;
+    delivery_t delivery = {DELIVERY_END, NULL, 0, 0};
+    int8_t read_buff[MIMPI_READ_BUFFER_SIZE];
+    int offset = 0;
+    int fillup = 0;
+
+    while (true) {
+        if (!thorough_read(read_buff, &offset, &fillup,
+                           &mt, sizeof(metadata_t), fd)) {
+
+            ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+            g_alive[src] = false;
+            ASSERT_SYS_OK(close(fd));
+
+            if (g_alive[rank] && g_write_open[src][lane]) {
+                uring_forget(write_fd(src, lane));
+                ASSERT_SYS_OK(close(write_fd(src, lane)));
+                g_write_open[src][lane] = false;
+            }
+
+            ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+
+            ASSERT_ZERO(pthread_mutex_lock(&g_reassembly[src].mutex));
+            g_reassembly[src].closed[lane] = true;
+            ASSERT_ZERO(pthread_cond_broadcast(&g_reassembly[src].cond));
+            ASSERT_ZERO(pthread_mutex_unlock(&g_reassembly[src].mutex));
+
+            delivery.kind = DELIVERY_END;
+            delivery_push(&g_queues[src][lane], &delivery);
+            delivery_notify(src);
+            break;
+        }
+
+        void* buff;
+
+        switch(mt.signal) {
+            case SEND:
+                if (lane >= LANE_STRIPES) {
+                    read_stripe(src, lane, &mt, read_buff, &offset, &fillup, fd);
+                    continue;
+                }
+
+                buff = malloc(mt.count);
+                if (mt.stripes == 1) {
+                    read_payload(read_buff, &offset, &fillup, &mt, buff, mt.count, fd);
+                } else if (!read_striped(src, &mt, buff, read_buff, &offset, &fillup, fd)) {
+                    free(buff);
+                    continue;
+                }
+
+                delivery.kind = DELIVERY_MESSAGE;
+                delivery.node = new_node(mt.context, mt.tag, src, mt.count, buff);
+                break;
+            case WAITING: // For deadlock detection.
+                delivery.kind = DELIVERY_WAITING;
+                delivery.num_recv = mt.num_recv;
+                delivery.num_sent = mt.num_sent;
+                break;
+        }
+        delivery_push(&g_queues[src][lane], &delivery);
+        delivery_notify(src);
+    }
+    return NULL;
+}
+
+// Moves the descriptors passed by mimpirun to their fixed places, first all of them out of the way,
+// so that none is overwritten by another.
+static void install_fds(int* fds, const int* targets, int num_fds) {
+    for (int i = 0; i < num_fds; i++) {
+        int scratch = fcntl(fds[i], F_DUPFD, MIMPI_SCRATCH_FD_MIN);
+        ASSERT_SYS_OK(scratch);
+        ASSERT_SYS_OK(close(fds[i]));
+        fds[i] = scratch;
+    }
+    for (int i = 0; i < num_fds; i++) {
+        ASSERT_SYS_OK(dup2(fds[i], targets[i]));
+        ASSERT_SYS_OK(close(fds[i]));
+    }
+}
+
+static void* listener_main(void* data) {
+    rendezvous_msg_t msg;
+    int fds[MIMPI_RENDEZVOUS_MAX_FDS];
+
+    while (true) {
+        int num_fds = rendezvous_recv(MIMPI_RENDEZVOUS_FD, &msg, fds);
+        if (num_fds == -1 || msg.type == RENDEZVOUS_BYE) break;
+
+        int peer = msg.peer;
+        ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+        if (msg.type == RENDEZVOUS_CHANNELS) {
+            int targets[MIMPI_RENDEZVOUS_MAX_FDS];
+
+            assert(num_fds == 2 * g_num_lanes);
+            for (int lane = 0; lane < g_num_lanes; lane++) {
+                targets[2 * lane] = read_fd(peer, lane);
+                targets[2 * lane + 1] = write_fd(peer, lane);
+            }
+            install_fds(fds, targets, num_fds);
+            for (int lane = 0; lane < g_num_lanes; lane++) channel_ends(write_fd(peer, lane), g_rank, peer);
+
+            for (int lane = 0; lane < g_num_lanes; lane++) {
+                int* thread_data = malloc(sizeof(int));
+                *thread_data = peer * MIMPI_MAX_LANES + lane;
+                g_write_open[peer][lane] = true;
+                ASSERT_ZERO(pthread_create(&thread[peer][lane], NULL, helper_main, thread_data));
+            }
+            g_has_helper[peer] = true;
+        } else {
+            g_alive[peer] = false;
+            g_ended[peer] = true;
+        }
+
+        g_connected[peer] = true;
+        ASSERT_ZERO(pthread_cond_broadcast(&g_connect));
+        ASSERT_ZERO(pthread_cond_signal(&g_progress));
+        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    }
+    return NULL;
+}
+
+// Asks mimpirun for channels with the process unless they have already been asked for.
+// Never to be performed outside a mutex!!!
+static void connect_start(int peer) {
+    if (g_connect_requested[peer]) return;
+
+    g_connect_requested[peer] = true;
+    rendezvous_send(MIMPI_RENDEZVOUS_FD, RENDEZVOUS_CONNECT, peer, NULL, 0);
+}
+
+// Waits until there are channels with the process or it is known to be gone.
+// Never to be performed outside a mutex!!!
+static void connect_wait(int peer) {
+    connect_start(peer);
+    while (!g_connected[peer]) {
+        ASSERT_ZERO(pthread_cond_wait(&g_connect, &g_mutex));
+    }
+}
+
+// Destination is a rank in the world, not in the communicator owning the context.
+static MIMPI_Retcode send_msg(
+        void const* data,
+        int count,
+        int destination,
+        int tag,
+        int context
+) {
+    int rank = g_rank;
+
+    if (destination == rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+
+    metadata_t mt;
+    mt.signal = SEND;
+    mt.context = context;
+    mt.tag = tag;
+    mt.count = count;
+    mt.num_recv = 0; // Initializing the data to avoid valgrind errors.
+    mt.num_sent = 0; // Initializing the data to avoid valgrind errors.
+    mt.stripes = 1;
+
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+    connect_wait(destination);
+    if (!g_alive[destination]) {
+        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+        return MIMPI_ERROR_REMOTE_FINISHED;
+    }
+
+    g_num_sent[destination]++;
+    g_is_waiting_on_recv[destination] = false;
+
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+
+    int lane = lane_of(count);
+    bool ret;
+
+    if (lane == LANE_DATA && g_num_stripes > 1 && count >= MIMPI_STRIPE_MIN_COUNT) {
+        ret = send_striped(mt, data, count, destination);
+    } else {
+        ASSERT_ZERO(pthread_mutex_lock(&g_write_mutex[destination][lane]));
+        ret = thorough_write(mt, data, count, write_fd(destination, lane), destination);
+        ASSERT_ZERO(pthread_mutex_unlock(&g_write_mutex[destination][lane]));
+    }
+
+    if (!ret) { return MIMPI_ERROR_REMOTE_FINISHED; }
+    else { return MIMPI_SUCCESS; }
+}
+
+// Sends the same message to every one of the processes, which are ranks in the world.
+// Through io_uring all of them are written in one batch, so the writes to different processes
+// go on at the same time, otherwise one after another with send_msg.
+static MIMPI_Retcode send_many(
+        void const* data,
+        int count,
+        const int* destinations,
+        int num,
+        int tag,
+        int context
+) {
+    int lane = lane_of(count);
+    bool striped = lane == LANE_DATA && g_num_stripes > 1 && count >= MIMPI_STRIPE_MIN_COUNT;
+
+    if (num <= 1 || num > MIMPI_URING_ENTRIES || striped || uring_get() == NULL) {
+        for (int i = 0; i < num; i++) {
+            MIMPI_Retcode ret = send_msg(data, count, destinations[i], tag, context);
+            if (ret != MIMPI_SUCCESS) return ret;
+        }
+        return MIMPI_SUCCESS;
+    }
+
+    frame_t frames[MIMPI_URING_ENTRIES];
+    int num_frames = 0;
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+    metadata_t mt;
+    mt.signal = SEND;
+    mt.context = context;
+    mt.tag = tag;
+    mt.count = count;
+    mt.num_recv = 0; // Initializing the data to avoid valgrind errors.
+    mt.num_sent = 0; // Initializing the data to avoid valgrind errors.
+    mt.stripes = 1;
+
+    for (int i = 0; i < num; i++) {
+        if (destinations[i] == g_rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+    }
+
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+    for (int i = 0; i < num; i++) {
+        connect_start(destinations[i]);
+    }
+    for (int i = 0; i < num; i++) {
+        int dest = destinations[i];
+
+        connect_wait(dest);
+        if (!g_alive[dest]) {
+            ret = MIMPI_ERROR_REMOTE_FINISHED;
+            continue;
+        }
+        g_num_sent[dest]++;
+        g_is_waiting_on_recv[dest] = false;
+
+        // Sorted by destination, the order in which write mutexes of several processes are locked.
+        int j = num_frames++;
+        for (; j > 0 && frames[j - 1].dest > dest; j--) {
+            frames[j] = frames[j - 1];
+        }
+        frames[j] = (frame_t) {mt, data, count, write_fd(dest, lane), dest, NULL, false};
+    }
+
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+
+    for (int i = 0; i < num_frames; i++) {
+        ASSERT_ZERO(pthread_mutex_lock(&g_write_mutex[frames[i].dest][lane]));
+    }
+    if (!write_frames(frames, num_frames)) ret = MIMPI_ERROR_REMOTE_FINISHED;
+    for (int i = num_frames - 1; i >= 0; i--) {
+        ASSERT_ZERO(pthread_mutex_unlock(&g_write_mutex[frames[i].dest][lane]));
+    }
+    return ret;
+}
+
+// Ends a receive with a detected deadlock, letting the other process detect it as well.
+// Never to be performed outside a mutex, which it unlocks!!!
+static MIMPI_Retcode report_deadlock(int source) {
+    int recv = g_num_recv[source];
+    int sent = g_num_sent[source];
+
+    g_is_waiting_on_recv[source] = false; // The other process will also detect a deadlock.
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+
+    send_waiting(source, recv, sent);
+    return MIMPI_ERROR_DEADLOCK_DETECTED;
+}
+
+// Waits for a matching message and hands it over already removed from the list,
+// so that it can be consumed without holding the mutex.
+// Source is a rank in the world, not in the communicator owning the context.
+static MIMPI_Retcode recv_node(
+        int count,
+        int source,
+        int tag,
+        int context,
+        buffer_node_t** node
+) {
+    int rank = g_rank;
+    int recv;
+    int sent;
+    MIMPI_Retcode ret;
+
+    if (source == rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+    connect_wait(source);
+    deliver_from(source);
+    *node = find_and_unlink(count, source, tag, context);
+    if (*node != NULL) {
+        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+        return MIMPI_SUCCESS;
+    }
+
+    if (g_ended[source]) {
+        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+        return MIMPI_ERROR_REMOTE_FINISHED;
+    }
+
+    if (g_is_waiting_on_recv[source] &&
+        g_num_sent_to_me[source] == g_num_recv[source]) { // There is a deadlock.
+
+        return report_deadlock(source);
+    }
+
+    // Lets a WAITING from source tell that both processes wait for each other.
+    g_source = source;
+    g_source_count = count;
+    g_source_tag = tag;
+    g_source_context = context;
+    g_deadlock_both = false;
+
+    recv = g_num_recv[source];
+    sent = g_num_sent[source];
+
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+
+    send_waiting(source, recv, sent);
+
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+    while (true) {
+        deliver_from(source);
+        *node = find_and_unlink(count, source, tag, context);
+
+        if (*node != NULL) { ret = MIMPI_SUCCESS; }
+        // The WAITING may come in one batch with the end of source, which has detected the deadlock too.
+        else if (g_deadlock_both) { ret = MIMPI_ERROR_DEADLOCK_DETECTED; }
+        else if (g_ended[source]) { ret = MIMPI_ERROR_REMOTE_FINISHED; }
+        else if (g_deadlock_detection && g_num_recv[source] != recv) { // Other messages have arrived.
+            if (g_is_waiting_on_recv[source] && g_num_sent_to_me[source] == g_num_recv[source]) { // Deadlock.
+                g_source = -1;
+                return report_deadlock(source);
+            }
+            recv = g_num_recv[source];
+            if (!g_is_waiting_on_recv[source]) {
+                sent = g_num_sent[source];
+
+                ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+                send_waiting(source, recv, sent);
+                ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+            }
+            continue;
+        }
+        else {
+            wait_for_delivery(source);
+            continue;
+        }
+
+        g_source = -1;
+        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+        return ret;
+    }
+}
+
+// Source is a rank in the world, not in the communicator owning the context.
+static MIMPI_Retcode recv_msg(
+        void* data,
+        int count,
+        int source,
+        int tag,
+        int context
+) {
+    buffer_node_t* node;
+    MIMPI_Retcode ret = recv_node(count, source, tag, context, &node);
+
+    if (ret != MIMPI_SUCCESS) return ret;
+
+    memcpy(data, node->data, count);
+    free_node(node);
+    return MIMPI_SUCCESS;
+}
+
+static MIMPI_Retcode comm_send(const comm_t* comm, void const* data, int count, int destination, int tag) {
+    return send_msg(data, count, comm->world_ranks[destination], tag, comm->context);
+}
+
+// Destinations are ranks in the communicator.
+static MIMPI_Retcode comm_send_many(const comm_t* comm, void const* data, int count,
+                                    const int* destinations, int num, int tag) {
+    int world_ranks[MIMPI_MAX_N];
+
+    for (int i = 0; i < num; i++) {
+        world_ranks[i] = comm->world_ranks[destinations[i]];
+    }
+    return send_many(data, count, world_ranks, num, tag, comm->context);
+}
+
+static MIMPI_Retcode comm_recv(const comm_t* comm, void* data, int count, int source, int tag) {
+    return recv_msg(data, count, comm->world_ranks[source], tag, comm->context);
+}
+
+// Hands over a matching message if it has already arrived, without waiting for it.
+static buffer_node_t* comm_try_recv_node(const comm_t* comm, int count, int source, int tag) {
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+    deliver_from(comm->world_ranks[source]);
+    buffer_node_t* node = find_and_unlink(count, comm->world_ranks[source], tag, comm->context);
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    return node;
+}
+
+// Works like comm_recv, but hands over the message itself instead of copying it.
+static MIMPI_Retcode comm_recv_node(const comm_t* comm, int count, int source, int tag, buffer_node_t** node) {
+    return recv_node(count, comm->world_ranks[source], tag, comm->context, node);
+}
+
+// Receives a dummy from every child and then sends one to the parent.
+static MIMPI_Retcode sync_up(const comm_t* comm, const tree_links_t* links) {
+    MIMPI_Retcode ret;
+    char dummy = '0'; // Initializing the data to avoid valgrind errors.
+
+    for (int i = 0; i < links->num_children; i++) {
+        ret = comm_recv(comm, &dummy, sizeof(char), links->children[i], -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+    }
+
+    if (links->parent != -1) {
+        ret = comm_send(comm, &dummy, sizeof(char), links->parent, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+    }
+    return MIMPI_SUCCESS;
+}
+
+// Receives a dummy from the parent and then sends one to every child.
+static MIMPI_Retcode sync_down(const comm_t* comm, const tree_links_t* links) {
+    MIMPI_Retcode ret;
+    char dummy = '0'; // Initializing the data to avoid valgrind errors.
+
+    if (links->parent != -1) {
+        ret = comm_recv(comm, &dummy, sizeof(char), links->parent, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+    }
+
+    ret = comm_send_many(comm, &dummy, sizeof(char), links->children, links->num_children, -1);
+    CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+    return MIMPI_SUCCESS;
+}
+
+static MIMPI_Retcode tree_barrier(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    const tree_links_t* links = &comm->trees[algo->sync_shape][0];
+    MIMPI_Retcode ret = sync_up(comm, links);
+
+    if (ret != MIMPI_SUCCESS) return ret;
+    return sync_down(comm, links);
+}
+
+// In round k every process signals the one 2^k ranks ahead and waits for the one 2^k ranks behind.
+static MIMPI_Retcode dissemination_barrier(const comm_t* comm,
+                                           const collective_args_t* args,
+                                           const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    char dummy = '0'; // Initializing the data to avoid valgrind errors.
+
+    for (int dist = 1; dist < comm->size; dist <<= 1) {
+        ret = comm_send(comm, &dummy, sizeof(char), (comm->rank + dist) % comm->size, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+
+        ret = comm_recv(comm, &dummy, sizeof(char), (comm->rank - dist + comm->size) % comm->size, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+    }
+    return MIMPI_SUCCESS;
+}
+
+static MIMPI_Retcode tree_bcast(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    const tree_links_t* links = &comm->trees[algo->shape][args->root];
+    u_int8_t* data = args->data;
+    int segment = algo->pipelined ? MIMPI_SEGMENT_SIZE : args->count;
+    int offset = 0;
+
+    if (comm->synchronizing) {
+        ret = sync_up(comm, &comm->trees[algo->sync_shape][args->root]);
+        if (ret != MIMPI_SUCCESS) return ret;
+    }
+
+    do {
+        int len = minimum(segment, args->count - offset);
+
+        if (links->parent != -1) {
+            ret = comm_recv(comm, data + offset, len, links->parent, -1);
+            CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+        }
+
+        ret = comm_send_many(comm, data + offset, len, links->children, links->num_children, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+
+        offset += len;
+    } while (offset < args->count);
+
+    return MIMPI_SUCCESS;
+}
+
+// Combines the segments of len bytes of all children into res. For commutative operations the ones
+// that have already arrived go first; otherwise children are taken in rank order, which for
+// the trees used with such operations is the reverse of their order in links.
+static MIMPI_Retcode combine_children(const comm_t* comm, const tree_links_t* links,
+                                      u_int8_t* res, int len, MIMPI_Op op, bool commutative) {
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+    bool done[MIMPI_MAX_TREE_CHILDREN] = {false};
+    buffer_node_t* node;
+    buffer_node_t* combined = NULL; // Message being combined into res in the background.
+
+    for (int left = links->num_children; left > 0; left--) {
+        int next = -1;
+        node = NULL;
+
+        for (int i = 0; i < links->num_children; i++) {
+            if (done[i]) continue;
+
+            if (commutative) {
+                node = comm_try_recv_node(comm, len, links->children[i], -1);
+                if (node) {
+                    next = i;
+                    break;
+                }
+                if (next == -1) next = i;
+            } else {
+                next = i;
+            }
+        }
+
+        if (node == NULL) { ret = comm_recv_node(comm, len, links->children[next], -1, &node); }
+
+        reduction_wait();
+        if (combined) { free_node(combined); }
+        combined = NULL;
+        if (ret != MIMPI_SUCCESS) return ret;
+
+        done[next] = true;
+        reduction_start(res, node->data, len, op);
+        combined = node;
+    }
+
+    reduction_wait();
+    if (combined) { free_node(combined); }
+    return MIMPI_SUCCESS;
+}
+
+// Segments of pipelined reductions fit in a single chsend, unless there is a pool of reducers,
+// which then gets segments big enough to be worth splitting among its threads.
+static int reduce_segment(const algorithm_t* algo, int count, MIMPI_Op op) {
+    int elem_size = op_elem_size(op);
+
+    if (!algo->pipelined) return count;
+    if (g_num_reducers > 0) return round_to_elems(MIMPI_PARALLEL_REDUCTION_MIN + elem_size - 1, elem_size);
+    return round_to_elems(MIMPI_SEGMENT_SIZE, elem_size);
+}
+
+static MIMPI_Retcode tree_reduce(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    bool commutative = op_commutative(args->op);
+    // A non-commutative operation needs every subtree to cover consecutive ranks, which binomial trees
+    // and chains rooted at 0 provide. The result is then passed from 0 to the root.
+    tree_shape_t shape = (commutative || algo->shape != TREE_BINARY) ? algo->shape : TREE_BINOMIAL;
+    int tree_root = commutative ? args->root : 0;
+    const tree_links_t* links = &comm->trees[shape][tree_root];
+    int count = args->count;
+    int segment = reduce_segment(algo, count, args->op);
+    int offset = 0;
+    u_int8_t* res = malloc(count);
+    memcpy(res, args->send_data, count);
+
+    // Helpers keep receiving the following segments while this one is combined and passed on.
+    do {
+        int len = minimum(segment, count - offset);
+
+        ret = combine_children(comm, links, res + offset, len, args->op, commutative);
+        if (ret != MIMPI_SUCCESS) {
+            free(res);
+            return ret;
+        }
+
+        if (links->parent != -1) {
+            ret = comm_send(comm, res + offset, len, links->parent, -1);
+            CHECK_IF_REMOTE_FINISHED(ret, res, NULL, NULL);
+        }
+
+        offset += len;
+    } while (offset < count);
+
+    if (tree_root == args->root) {
+        if (links->parent == -1) { memcpy(args->recv_data, res, count); }
+    } else if (comm->rank == tree_root) {
+        ret = comm_send(comm, res, count, args->root, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, res, NULL, NULL);
+    } else if (comm->rank == args->root) {
+        ret = comm_recv(comm, args->recv_data, count, tree_root, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, res, NULL, NULL);
+    }
+
+    free(res);
+
+    if (!comm->synchronizing) return MIMPI_SUCCESS;
+    return sync_down(comm, &comm->trees[algo->sync_shape][args->root]);
+}
+
+// After the round with distance k, tmp holds the blocks of the 2k processes following this one.
+static MIMPI_Retcode bruck_allgather(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int n = comm->size;
+    int count = args->count;
+    u_int8_t* tmp = malloc((size_t) n * count);
+    u_int8_t* recv_data = args->recv_data;
+    memcpy(tmp, args->send_data, count);
+
+    for (int k = 1; k < n; k <<= 1) {
+        int blocks = minimum(k, n - k);
+
+        ret = comm_send(comm, tmp, blocks * count, (comm->rank - k + n) % n, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, tmp, NULL, NULL);
+
+        ret = comm_recv(comm, tmp + (size_t) k * count, blocks * count, (comm->rank + k) % n, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, tmp, NULL, NULL);
+    }
+
+    for (int i = 0; i < n; i++) {
+        memcpy(recv_data + (size_t) ((comm->rank + i) % n) * count, tmp + (size_t) i * count, count);
+    }
+
+    free(tmp);
+    return MIMPI_SUCCESS;
+}
+
+// In step s every process passes the block it got in step s - 1 to its right neighbour.
+static MIMPI_Retcode ring_allgather(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int n = comm->size;
+    int count = args->count;
+    int right = (comm->rank + 1) % n;
+    int left = (comm->rank - 1 + n) % n;
+    u_int8_t* recv_data = args->recv_data;
+    memcpy(recv_data + (size_t) comm->rank * count, args->send_data, count);
+
+    for (int s = 0; s < n - 1; s++) {
+        int send_block = (comm->rank - s + n) % n;
+        int recv_block = (comm->rank - s - 1 + n) % n;
+
+        ret = comm_send(comm, recv_data + (size_t) send_block * count, count, right, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+
+        ret = comm_recv(comm, recv_data + (size_t) recv_block * count, count, left, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+    }
+    return MIMPI_SUCCESS;
+}
+
+// Blocks are rotated so that block i is destined for the process i ranks ahead. In the round
+// with distance k every block with bit k set in its index moves k ranks ahead, so after
+// all rounds each block has reached its destination. The final rotation restores rank order.
+static MIMPI_Retcode bruck_alltoall(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int n = comm->size;
+    int count = args->count;
+    const u_int8_t* send_data = args->send_data;
+    u_int8_t* recv_data = args->recv_data;
+    u_int8_t* tmp = malloc((size_t) n * count);
+    u_int8_t* packed = malloc((size_t) ((n + 1) / 2) * count);
+
+    for (int i = 0; i < n; i++) {
+        memcpy(tmp + (size_t) i * count, send_data + (size_t) ((comm->rank + i) % n) * count, count);
+    }
+
+    for (int k = 1; k < n; k <<= 1) {
+        int blocks = 0;
+        for (int i = k; i < n; i++) {
+            if (i & k) memcpy(packed + (size_t) (blocks++) * count, tmp + (size_t) i * count, count);
+        }
+
+        ret = comm_send(comm, packed, blocks * count, (comm->rank + k) % n, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, tmp, packed, NULL);
+
+        ret = comm_recv(comm, packed, blocks * count, (comm->rank - k + n) % n, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, tmp, packed, NULL);
+
+        blocks = 0;
+        for (int i = k; i < n; i++) {
+            if (i & k) memcpy(tmp + (size_t) i * count, packed + (size_t) (blocks++) * count, count);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        memcpy(recv_data + (size_t) ((comm->rank - i + n) % n) * count, tmp + (size_t) i * count, count);
+    }
+
+    free(tmp);
+    free(packed);
+    return MIMPI_SUCCESS;
+}
+
+// In step s every process sends to the one s ranks ahead and receives from the one s ranks behind,
+// so no two processes send to the same one at once.
+static MIMPI_Retcode pairwise_alltoall(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int n = comm->size;
+    int count = args->count;
+    const u_int8_t* send_data = args->send_data;
+    u_int8_t* recv_data = args->recv_data;
+    memcpy(recv_data + (size_t) comm->rank * count, send_data + (size_t) comm->rank * count, count);
+
+    for (int s = 1; s < n; s++) {
+        int dest = (comm->rank + s) % n;
+        int src = (comm->rank - s + n) % n;
+
+        ret = comm_send(comm, send_data + (size_t) dest * count, count, dest, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+
+        ret = comm_recv(comm, recv_data + (size_t) src * count, count, src, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+    }
+    return MIMPI_SUCCESS;
+}
+
+// Number of processes in the binomial subtree rooted at the process with distance rel from the root.
+static int binomial_extent(int rel, int size) {
+    int mask = 1;
+
+    while (mask < size && !(rel & mask)) mask <<= 1;
+    return minimum(mask, size - rel);
+}
+
+static int sum_counts(const int* counts, int num) {
+    int sum = 0;
+    for (int i = 0; i < num; i++) sum += counts[i];
+    return sum;
+}
+
+// Count of the block of the process at distance rel from the root (significant only in the root).
+static int block_count(const collective_args_t* args, int n, int rel) {
+    return args->variable ? args->counts[(rel + args->root) % n] : args->count;
+}
+
+// Offset of the block of the process at distance rel from the root (significant only in the root).
+static size_t block_displ(const collective_args_t* args, int n, int rel) {
+    int rank = (rel + args->root) % n;
+    return args->variable ? (size_t) args->displs[rank] : (size_t) rank * args->count;
+}
+
+// Every process collects the blocks of its binomial subtree, ordered by distance from the root,
+// and passes them to its parent in a single message. For variable counts the counts of the subtree
+// are passed up first, since only the root knows them.
+static MIMPI_Retcode binomial_gather(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int n = comm->size;
+    int rel = (comm->rank - args->root + n) % n;
+    int extent = binomial_extent(rel, n);
+    const tree_links_t* links = &comm->trees[TREE_BINOMIAL][args->root];
+    int* counts = malloc(extent * sizeof(int));
+    bool variable = args->variable;
+
+    for (int i = 0; i < extent; i++) counts[i] = args->count;
+    counts[0] = args->send_count;
+
+    if (variable) {
+        for (int i = 0; i < links->num_children; i++) {
+            int child = (links->children[i] - args->root + n) % n;
+
+            ret = comm_recv(comm, counts + child - rel,
+                            binomial_extent(child, n) * sizeof(int), links->children[i], -1);
+            CHECK_IF_REMOTE_FINISHED(ret, counts, NULL, NULL);
+        }
+
+        if (links->parent != -1) {
+            ret = comm_send(comm, counts, extent * sizeof(int), links->parent, -1);
+            CHECK_IF_REMOTE_FINISHED(ret, counts, NULL, NULL);
+        }
+    }
+
+    u_int8_t* tmp = malloc(sum_counts(counts, extent));
+    memcpy(tmp, args->send_data, args->send_count);
+
+    for (int i = 0; i < links->num_children; i++) {
+        int child = (links->children[i] - args->root + n) % n;
+        int offset = sum_counts(counts, child - rel);
+
+        ret = comm_recv(comm, tmp + offset, sum_counts(counts + child - rel, binomial_extent(child, n)),
+                        links->children[i], -1);
+        CHECK_IF_REMOTE_FINISHED(ret, counts, tmp, NULL);
+    }
+
+    if (links->parent != -1) {
+        ret = comm_send(comm, tmp, sum_counts(counts, extent), links->parent, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, counts, tmp, NULL);
+    } else {
+        u_int8_t* recv_data = args->recv_data;
+        int offset = 0;
+
+        for (int i = 0; i < n; i++) {
+            memcpy(recv_data + block_displ(args, n, i), tmp + offset, counts[i]);
+            offset += counts[i];
+        }
+    }
+
+    free(counts);
+    free(tmp);
+    return MIMPI_SUCCESS;
+}
+
+// The root sends every child the blocks of its binomial subtree in a single message
+// (preceded by their counts if they are variable), and each process passes them on.
+static MIMPI_Retcode binomial_scatter(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int n = comm->size;
+    int rel = (comm->rank - args->root + n) % n;
+    int extent = binomial_extent(rel, n);
+    const tree_links_t* links = &comm->trees[TREE_BINOMIAL][args->root];
+    int* counts = malloc(extent * sizeof(int));
+    bool variable = args->variable;
+    u_int8_t* tmp;
+
+    if (links->parent == -1) {
+        const u_int8_t* send_data = args->send_data;
+        int offset = 0;
+
+        for (int i = 0; i < n; i++) counts[i] = block_count(args, n, i);
+        tmp = malloc(sum_counts(counts, n));
+        for (int i = 0; i < n; i++) {
+            memcpy(tmp + offset, send_data + block_displ(args, n, i), counts[i]);
+            offset += counts[i];
+        }
+    } else {
+        for (int i = 0; i < extent; i++) counts[i] = args->count;
+
+        if (variable) {
+            ret = comm_recv(comm, counts, extent * sizeof(int), links->parent, -1);
+            CHECK_IF_REMOTE_FINISHED(ret, counts, NULL, NULL);
+        }
+
+        tmp = malloc(sum_counts(counts, extent));
+        ret = comm_recv(comm, tmp, sum_counts(counts, extent), links->parent, -1);
+        CHECK_IF_REMOTE_FINISHED(ret, counts, tmp, NULL);
+    }
+
+    for (int i = 0; i < links->num_children; i++) {
+        int child = (links->children[i] - args->root + n) % n;
+        int child_extent = binomial_extent(child, n);
+
+        if (variable) {
+            ret = comm_send(comm, counts + child - rel, child_extent * sizeof(int), links->children[i], -1);
+            CHECK_IF_REMOTE_FINISHED(ret, counts, tmp, NULL);
+        }
+
+        ret = comm_send(comm, tmp + sum_counts(counts, child - rel),
+                        sum_counts(counts + child - rel, child_extent), links->children[i], -1);
+        CHECK_IF_REMOTE_FINISHED(ret, counts, tmp, NULL);
+    }
+
+    memcpy(args->recv_data, tmp, counts[0]);
+
+    free(counts);
+    free(tmp);
+    return MIMPI_SUCCESS;
+}
+
+static MIMPI_Retcode linear_gather(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int n = comm->size;
+    u_int8_t* recv_data = args->recv_data;
+
+    if (comm->rank != args->root) {
+        return comm_send(comm, args->send_data, args->send_count, args->root, -1);
+    }
+
+    for (int i = 0; i < n; i++) {
+        int rel = (i - args->root + n) % n;
+
+        if (i == comm->rank) {
+            memcpy(recv_data + block_displ(args, n, rel), args->send_data, args->send_count);
+        } else {
+            ret = comm_recv(comm, recv_data + block_displ(args, n, rel), block_count(args, n, rel), i, -1);
+            CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+        }
+    }
+    return MIMPI_SUCCESS;
+}
+
+static MIMPI_Retcode linear_scatter(const comm_t* comm, const collective_args_t* args, const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int n = comm->size;
+    const u_int8_t* send_data = args->send_data;
+
+    if (comm->rank != args->root) {
+        return comm_recv(comm, args->recv_data, args->recv_count, args->root, -1);
+    }
+
+    for (int i = 0; i < n; i++) {
+        int rel = (i - args->root + n) % n;
+
+        if (i == comm->rank) {
+            memcpy(args->recv_data, send_data + block_displ(args, n, rel), block_count(args, n, rel));
+        } else {
+            ret = comm_send(comm, send_data + block_displ(args, n, rel), block_count(args, n, rel), i, -1);
+            CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+        }
+    }
+    return MIMPI_SUCCESS;
+}
+
+// Before the round with distance d, partial holds the data of this process combined with
+// the data of the d - 1 processes preceding it. Exclusive scan keeps the same without its own data.
+static MIMPI_Retcode recursive_doubling_scan(const comm_t* comm,
+                                             const collective_args_t* args,
+                                             const algorithm_t* algo) {
+    MIMPI_Retcode ret;
+    int count = args->count;
+    u_int8_t* partial = malloc(count);
+    u_int8_t* excl = args->exclusive ? malloc(count) : NULL;
+    bool has_excl = false;
+    buffer_node_t* node;
+    memcpy(partial, args->send_data, count);
+
+    for (int d = 1; d < comm->size; d <<= 1) {
+        if (comm->rank + d < comm->size) {
+            ret = comm_send(comm, partial, count, comm->rank + d, -1);
+            CHECK_IF_REMOTE_FINISHED(ret, partial, excl, NULL);
+        }
+
+        if (comm->rank - d < 0) continue;
+
+        ret = comm_recv_node(comm, count, comm->rank - d, -1, &node);
+        if (ret != MIMPI_SUCCESS) {
+            free(partial);
+            free(excl);
+            return ret;
+        }
+
+        // Data of preceding processes always goes on the left of the operation.
+        if (args->exclusive) {
+            if (has_excl) {
+                u_int8_t* combined = malloc(count);
+                memcpy(combined, node->data, count);
+                reduction_start(combined, excl, count, args->op);
+                reduction_wait();
+                free(excl);
+                excl = combined;
+            } else {
+                memcpy(excl, node->data, count);
+                has_excl = true;
+            }
+        }
+
+        reduction_start(node->data, partial, count, args->op);
+        reduction_wait();
+        u_int8_t* combined = node->data;
+        node->data = partial;
+        partial = combined;
+        free_node(node);
+    }
+
+    if (!args->exclusive) {
+        memcpy(args->recv_data, partial, count);
+    } else if (has_excl) {
+        memcpy(args->recv_data, excl, count);
+    }
+
+    free(partial);
+    free(excl);
+    return MIMPI_SUCCESS;
+}
+
+/* Algorithm Selection */
+static const algorithm_t g_barrier_algorithms[] = {
+    {"binary", tree_barrier, TREE_BINARY, TREE_BINARY, false},
+    {"binomial", tree_barrier, TREE_BINOMIAL, TREE_BINOMIAL, false},
+    {"dissemination", dissemination_barrier, TREE_BINARY, TREE_BINARY, false},
+};
+
+static const algorithm_t g_bcast_algorithms[] = {
+    {"binary", tree_bcast, TREE_BINARY, TREE_BINARY, false},
+    {"binomial", tree_bcast, TREE_BINOMIAL, TREE_BINOMIAL, false},
+    {"binomial_pipelined", tree_bcast, TREE_BINOMIAL, TREE_BINOMIAL, true},
+    {"chain", tree_bcast, TREE_CHAIN, TREE_BINOMIAL, true},
+};
+
+static const algorithm_t g_reduce_algorithms[] = {
+    {"binary", tree_reduce, TREE_BINARY, TREE_BINARY, false},
+    {"binomial", tree_reduce, TREE_BINOMIAL, TREE_BINOMIAL, false},
+    {"binomial_pipelined", tree_reduce, TREE_BINOMIAL, TREE_BINOMIAL, true},
+    {"chain", tree_reduce, TREE_CHAIN, TREE_BINOMIAL, true},
+};
+
+static const algorithm_t g_allgather_algorithms[] = {
+    {"bruck", bruck_allgather, TREE_BINARY, TREE_BINARY, false},
+    {"ring", ring_allgather, TREE_BINARY, TREE_BINARY, false},
+};
+
+static const algorithm_t g_alltoall_algorithms[] = {
+    {"bruck", bruck_alltoall, TREE_BINARY, TREE_BINARY, false},
+    {"pairwise", pairwise_alltoall, TREE_BINARY, TREE_BINARY, false},
+};
+
+static const algorithm_t g_gather_algorithms[] = {
+    {"binomial", binomial_gather, TREE_BINOMIAL, TREE_BINOMIAL, false},
+    {"linear", linear_gather, TREE_BINOMIAL, TREE_BINOMIAL, false},
+};
+
+static const algorithm_t g_scatter_algorithms[] = {
+    {"binomial", binomial_scatter, TREE_BINOMIAL, TREE_BINOMIAL, false},
+    {"linear", linear_scatter, TREE_BINOMIAL, TREE_BINOMIAL, false},
+};
+
+static const algorithm_t g_scan_algorithms[] = {
+    {"recursive_doubling", recursive_doubling_scan, TREE_BINARY, TREE_BINARY, false},
+};
+
+#define ALGORITHMS(array) array, sizeof(array) / sizeof(algorithm_t)
+
+static const collective_t g_collectives[NUM_COLLECTIVES] = {
+    [COLL_BARRIER] = {"barrier", ALGORITHMS(g_barrier_algorithms)},
+    [COLL_BCAST] = {"bcast", ALGORITHMS(g_bcast_algorithms)},
+    [COLL_REDUCE] = {"reduce", ALGORITHMS(g_reduce_algorithms)},
+    [COLL_ALLGATHER] = {"allgather", ALGORITHMS(g_allgather_algorithms)},
+    [COLL_ALLTOALL] = {"alltoall", ALGORITHMS(g_alltoall_algorithms)},
+    [COLL_GATHER] = {"gather", ALGORITHMS(g_gather_algorithms)},
+    [COLL_SCATTER] = {"scatter", ALGORITHMS(g_scatter_algorithms)},
+    [COLL_SCAN] = {"scan", ALGORITHMS(g_scan_algorithms)},
+};
+
+// Entries have the format: collective max_size max_count algorithm, where '*' means no limit.
+static const char* const g_default_tuning[] = {
+    "barrier * * dissemination",
+    "bcast * 16384 binomial",
+    "bcast * * chain",
+    "reduce * 16384 binomial",
+    "reduce * * chain",
+    "allgather * 1024 bruck",
+    "allgather * * ring",
+    "alltoall * 256 bruck",
+    "alltoall * * pairwise",
+    "gather * * binomial",
+    "scatter * * binomial",
+    "scan * * recursive_doubling",
+};
+
+static tuning_entry_t g_tuning[MIMPI_MAX_TUNING_ENTRIES];
+static int g_num_tuning;
+
+static int find_collective(const char* name) {
+    for (int i = 0; i < NUM_COLLECTIVES; i++) {
+        if (strcmp(g_collectives[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int find_algorithm(collective_kind_t coll, const char* name) {
+    for (int i = 0; i < g_collectives[coll].num_algorithms; i++) {
+        if (strcmp(g_collectives[coll].algorithms[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int parse_limit(const char* str) {
+    return (strcmp(str, "*") == 0) ? INT_MAX : atoi(str);
+}
+
+static void add_tuning_entry(const char* line) {
+    char coll_name[32];
+    char size[16];
+    char count[16];
+    char algo_name[32];
+
+    while (*line == ' ' || *line == '\t') line++;
+    if (*line == '\0' || *line == '\n' || *line == '#') return; // Empty lines and comments.
+
+    if (sscanf(line, "%31s %15s %15s %31s", coll_name, size, count, algo_name) != 4) {
+        fatal("Malformed tuning entry: %s", line);
+    }
+
+    int coll = find_collective(coll_name);
+    if (coll == -1) fatal("Unknown collective in tuning entry: %s", line);
+
+    int algo = find_algorithm(coll, algo_name);
+    if (algo == -1) fatal("Unknown algorithm in tuning entry: %s", line);
+
+    if (g_num_tuning == MIMPI_MAX_TUNING_ENTRIES) fatal("Too many tuning entries (at most %d).",
+                                                        MIMPI_MAX_TUNING_ENTRIES);
+
+    g_tuning[g_num_tuning].collective = coll;
+    g_tuning[g_num_tuning].max_size = parse_limit(size);
+    g_tuning[g_num_tuning].max_count = parse_limit(count);
+    g_tuning[g_num_tuning].algorithm = algo;
+    g_num_tuning++;
+}
+
+// Entries from MIMPI_TUNING (separated by ';') take precedence over the ones
+// from the file named by MIMPI_TUNING_FILE, which take precedence over the defaults.
+static void load_tuning() {
+    g_num_tuning = 0;
+
+    const char* inline_tuning = getenv("MIMPI_TUNING");
+    if (inline_tuning) {
+        char* entries = strdup(inline_tuning);
+        char* saveptr;
+
+        for (char* entry = strtok_r(entries, ";", &saveptr); entry; entry = strtok_r(NULL, ";", &saveptr)) {
+            add_tuning_entry(entry);
+        }
+        free(entries);
+    }
+
+    const char* tuning_path = getenv("MIMPI_TUNING_FILE");
+    if (tuning_path) {
+        FILE* file = fopen(tuning_path, "r");
+        if (file == NULL) syserr("Cannot open tuning file %s", tuning_path);
+
+        char* line = NULL;
+        size_t line_size = 0;
+        while (getline(&line, &line_size, file) != -1) {
+            add_tuning_entry(line);
+        }
+        free(line);
+        fclose(file);
+    }
+
+    for (int i = 0; i < sizeof(g_default_tuning) / sizeof(char*); i++) {
+        add_tuning_entry(g_default_tuning[i]);
+    }
+}
+
+static const algorithm_t* select_algorithm(collective_kind_t coll, int size, int count) {
+    for (int i = 0; i < g_num_tuning; i++) {
+        if (g_tuning[i].collective == coll &&
+            size <= g_tuning[i].max_size &&
+            count <= g_tuning[i].max_count) {
+            return &g_collectives[coll].algorithms[g_tuning[i].algorithm];
+        }
+    }
+    return &g_collectives[coll].algorithms[0];
+}
+
+static MIMPI_Retcode run_collective(const comm_t* comm, collective_kind_t coll, const collective_args_t* args) {
+    const algorithm_t* algo = select_algorithm(coll, comm->size, args->count);
+    return algo->fn(comm, args, algo);
+}
+
+static MIMPI_Retcode comm_barrier(const comm_t* comm) {
+    collective_args_t args = {.count = 0};
+    return run_collective(comm, COLL_BARRIER, &args);
+}
+
+static MIMPI_Retcode comm_bcast(const comm_t* comm, void* data, int count, int root) {
+    if (root < 0 || root >= comm->size) return MIMPI_ERROR_NO_SUCH_RANK;
+
+    collective_args_t args = {.data = data, .count = count, .root = root};
+    return run_collective(comm, COLL_BCAST, &args);
+}
+
+static MIMPI_Retcode comm_reduce(
+        const comm_t* comm,
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Op op,
+        int root
+) {
+    if (root < 0 || root >= comm->size) return MIMPI_ERROR_NO_SUCH_RANK;
+    if (!op_valid(op) || count % op_elem_size(op) != 0) return MIMPI_ERROR_INVALID_OP;
+
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .count = count, .op = op, .root = root};
+    return run_collective(comm, COLL_REDUCE, &args);
+}
+
+static MIMPI_Retcode comm_allgather(const comm_t* comm, void const* send_data, void* recv_data, int count) {
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .count = count};
+    return run_collective(comm, COLL_ALLGATHER, &args);
+}
+
+static MIMPI_Retcode comm_alltoall(const comm_t* comm, void const* send_data, void* recv_data, int count) {
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .count = count};
+    return run_collective(comm, COLL_ALLTOALL, &args);
+}
+
+static MIMPI_Retcode comm_scan(const comm_t* comm, const collective_args_t* args) {
+    if (!op_valid(args->op) || args->count % op_elem_size(args->op) != 0) return MIMPI_ERROR_INVALID_OP;
+
+    return run_collective(comm, COLL_SCAN, args);
+}
+
+static MIMPI_Retcode comm_gather(const comm_t* comm, const collective_args_t* args) {
+    if (args->root < 0 || args->root >= comm->size) return MIMPI_ERROR_NO_SUCH_RANK;
+
+    return run_collective(comm, COLL_GATHER, args);
+}
+
+static MIMPI_Retcode comm_scatter(const comm_t* comm, const collective_args_t* args) {
+    if (args->root < 0 || args->root >= comm->size) return MIMPI_ERROR_NO_SUCH_RANK;
+
+    return run_collective(comm, COLL_SCATTER, args);
+}
+
+/* Autotuning */
+static long now_ns() {
+    struct timespec ts;
+    ASSERT_SYS_OK(clock_gettime(CLOCK_MONOTONIC, &ts));
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Returns (in the process with rank 0) the time the slowest process spent running the algorithm.
+static long measure_algorithm(const comm_t* comm, const algorithm_t* algo, collective_args_t* args) {
+    long elapsed;
+    long other;
+
+    if (tree_barrier(comm, args, &g_barrier_algorithms[0]) != MIMPI_SUCCESS) fatal("Autotuning failed.");
+
+    long start = now_ns();
+    for (int i = 0; i < MIMPI_AUTOTUNE_REPS; i++) {
+        if (algo->fn(comm, args, algo) != MIMPI_SUCCESS) fatal("Autotuning failed.");
+    }
+    elapsed = now_ns() - start;
+
+    if (comm->rank != 0) {
+        if (comm_send(comm, &elapsed, sizeof(long), 0, -1) != MIMPI_SUCCESS) fatal("Autotuning failed.");
+    } else {
+        for (int i = 1; i < comm->size; i++) {
+            if (comm_recv(comm, &other, sizeof(long), i, -1) != MIMPI_SUCCESS) fatal("Autotuning failed.");
+            if (other > elapsed) elapsed = other;
+        }
+    }
+    return elapsed;
+}
+
+// Measures every algorithm of every collective in the world for message sizes
+// 1, 16, 256, ... up to MIMPI_AUTOTUNE_MAX_COUNT (65536 by default), puts the fastest ones
+// in front of the tuning table and writes them to the file at path (in the format of MIMPI_TUNING_FILE).
+static void autotune(const char* path) {
+    const comm_t* world = &g_comms[MIMPI_COMM_WORLD];
+    const char* max_count_str = getenv("MIMPI_AUTOTUNE_MAX_COUNT");
+    int max_count = max_count_str ? atoi(max_count_str) : 65536;
+    int counts[16];
+    int num_counts = 0;
+
+    for (long count = 1; count <= max_count && num_counts < 16; count *= 16) {
+        counts[num_counts++] = count;
+    }
+
+    // The exchanging collectives need a block for every process.
+    u_int8_t* send_buf = calloc((size_t) max_count * g_size, 1);
+    u_int8_t* recv_buf = calloc((size_t) max_count * g_size, 1);
+    tuning_entry_t tuned[MIMPI_MAX_TUNING_ENTRIES];
+    int num_tuned = 0;
+
+    for (int coll = 0; coll < NUM_COLLECTIVES; coll++) {
+        for (int c = 0; c < num_counts; c++) {
+            // The barrier carries no data, so it is measured only once.
+            int count = (coll == COLL_BARRIER) ? 0 : counts[c];
+            collective_args_t args = {.data = send_buf, .send_data = send_buf, .recv_data = recv_buf,
+                                      .count = count, .op = MIMPI_SUM, .send_count = count, .recv_count = count};
+            long best_time = LONG_MAX;
+            int best = 0;
+
+            for (int a = 0; a < g_collectives[coll].num_algorithms; a++) {
+                long time = measure_algorithm(world, &g_collectives[coll].algorithms[a], &args);
+                if (time < best_time) {
+                    best_time = time;
+                    best = a;
+                }
+            }
+
+            // Only the process with rank 0 knows the times, so it decides for everybody.
+            collective_args_t best_args = {.data = &best, .count = sizeof(int)};
+            if (tree_bcast(world, &best_args, &g_bcast_algorithms[0]) != MIMPI_SUCCESS) fatal("Autotuning failed.");
+
+            tuned[num_tuned].collective = coll;
+            tuned[num_tuned].max_size = g_size;
+            // Every measured size stands for the sizes up to the geometric middle of the next one.
+            tuned[num_tuned].max_count = (coll == COLL_BARRIER || c == num_counts - 1) ? INT_MAX : count * 4;
+            tuned[num_tuned].algorithm = best;
+            num_tuned++;
+
+            if (coll == COLL_BARRIER) break;
+        }
+    }
+
+    free(send_buf);
+    free(recv_buf);
+
+    if (num_tuned + g_num_tuning > MIMPI_MAX_TUNING_ENTRIES) fatal("Too many tuning entries (at most %d).",
+                                                                   MIMPI_MAX_TUNING_ENTRIES);
+    memmove(g_tuning + num_tuned, g_tuning, g_num_tuning * sizeof(tuning_entry_t));
+    memcpy(g_tuning, tuned, num_tuned * sizeof(tuning_entry_t));
+    g_num_tuning += num_tuned;
+
+    if (g_rank == 0) {
+        FILE* file = fopen(path, "w");
+        if (file == NULL) syserr("Cannot open autotuning output file %s", path);
+
+        fprintf(file, "# collective max_size max_count algorithm\n");
+        for (int i = 0; i < num_tuned; i++) {
+            const collective_t* coll = &g_collectives[tuned[i].collective];
+
+            fprintf(file, "%s %d ", coll->name, tuned[i].max_size);
+            if (tuned[i].max_count == INT_MAX) fprintf(file, "* ");
+            else fprintf(file, "%d ", tuned[i].max_count);
+            fprintf(file, "%s\n", coll->algorithms[tuned[i].algorithm].name);
+        }
+        fclose(file);
+    }
+}
+
+// Gathers the split arguments of every member of comm in all of them.
+static MIMPI_Retcode exchange_split_info(const comm_t* comm, int* info) {
+    MIMPI_Retcode ret;
+    int* mine = info + comm->rank * 3;
+
+    if (comm->rank == 0) {
+        for (int i = 1; i < comm->size; i++) {
+            ret = comm_recv(comm, info + i * 3, 3 * sizeof(int), i, -1);
+            if (ret != MIMPI_SUCCESS) return ret;
+        }
+    } else {
+        ret = comm_send(comm, mine, 3 * sizeof(int), 0, -1);
+        if (ret != MIMPI_SUCCESS) return ret;
+    }
+
+    return comm_bcast(comm, info, comm->size * 3 * sizeof(int), 0);
+}
+
+/* Neighbourhood Collectives */
+static void topology_setup(comm_t* comm, int indegree, const int* sources, int outdegree, const int* destinations) {
+    comm->has_topology = true;
+    comm->indegree = indegree;
+    comm->outdegree = outdegree;
+    memcpy(comm->sources, sources, indegree * sizeof(int));
+    memcpy(comm->destinations, destinations, outdegree * sizeof(int));
+
+    // Every process starts with the destination following it, so that the first messages
+    // of all processes go to different ones. The sort is stable, which keeps messages to
+    // the same destination in order.
+    for (int i = 0; i < outdegree; i++) {
+        int dist = (destinations[i] - comm->rank + comm->size) % comm->size;
+        int j = i;
+        while (j > 0 && (comm->destinations[comm->send_order[j - 1]] - comm->rank + comm->size) % comm->size > dist) {
+            comm->send_order[j] = comm->send_order[j - 1];
+            j--;
+        }
+        comm->send_order[j] = i;
+    }
+}
+
+static MIMPI_Retcode topology_check(int degree, const int* neighbors, const comm_t* comm) {
+    if (degree < 0 || degree > MIMPI_MAX_NEIGHBORS) return MIMPI_ERROR_INVALID_TOPOLOGY;
+
+    for (int i = 0; i < degree; i++) {
+        if (neighbors[i] == comm->rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+        if (neighbors[i] < 0 || neighbors[i] >= comm->size) return MIMPI_ERROR_NO_SUCH_RANK;
+    }
+    return MIMPI_SUCCESS;
+}
+
+// Receives a block of count bytes from every source into consecutive blocks of recv_data.
+// Blocks are taken as they arrive, except that the ones from the same source go in order.
+static MIMPI_Retcode neighbor_recv(const comm_t* comm, u_int8_t* recv_data, int count) {
+    MIMPI_Retcode ret;
+    bool done[MIMPI_MAX_NEIGHBORS] = {false};
+    buffer_node_t* node;
+
+    for (int left = comm->indegree; left > 0; left--) {
+        int next = -1;
+        node = NULL;
+
+        for (int i = 0; i < comm->indegree && node == NULL; i++) {
+            bool first_from_source = !done[i];
+            for (int j = 0; j < i && first_from_source; j++) {
+                if (!done[j] && comm->sources[j] == comm->sources[i]) first_from_source = false;
+            }
+            if (!first_from_source) continue;
+
+            if (next == -1) next = i;
+            node = comm_try_recv_node(comm, count, comm->sources[i], -1);
+            if (node) next = i;
+        }
+
+        if (node == NULL) {
+            ret = comm_recv_node(comm, count, comm->sources[next], -1, &node);
+            CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+        }
+
+        memcpy(recv_data + (size_t) next * count, node->data, count);
+        free_node(node);
+        done[next] = true;
+    }
+    return MIMPI_SUCCESS;
+}
+
+// Sends everything up front, which never blocks for long since the helpers keep receiving,
+// and then collects the blocks of the sources. Destination i gets the block at send_data
+// shifted by i * stride bytes.
+static MIMPI_Retcode neighbor_exchange(const comm_t* comm, const u_int8_t* send_data, size_t stride,
+                                       void* recv_data, int count) {
+    MIMPI_Retcode ret;
+
+    for (int k = 0; k < comm->outdegree; k++) {
+        int i = comm->send_order[k];
+        ret = comm_send(comm, send_data + i * stride, count, comm->destinations[i], -1);
+        CHECK_IF_REMOTE_FINISHED(ret, NULL, NULL, NULL);
+    }
+    return neighbor_recv(comm, recv_data, count);
+}
+
+/* Non-blocking Collectives */
+static void request_init(request_t* req, comm_t* comm, MIMPI_Op op) {
+    req->used = true;
+    req->done = false;
+    req->ret = MIMPI_SUCCESS;
+    req->comm = comm;
+    req->tag = -2 - comm->num_requests;
+    comm->num_requests = (comm->num_requests + 1) % MIMPI_REQUEST_TAGS;
+    req->op = op;
+    req->commutative = op_commutative(op);
+    req->steps = NULL;
+    req->num_steps = 0;
+    req->max_steps = 0;
+    req->first = 0;
+    req->tmp = NULL;
+}
+
+static void schedule_add(request_t* req, step_kind_t kind, int round, int peer, void* buf, int count) {
+    if (req->num_steps == req->max_steps) {
+        req->max_steps = maximum(2 * req->max_steps, 8);
+        req->steps = realloc(req->steps, req->max_steps * sizeof(step_t));
+        if (req->steps == NULL) fatal("Out of memory for a schedule of %d steps", req->max_steps);
+    }
+
+    step_t* step = &req->steps[req->num_steps++];
+    step->kind = kind;
+    step->round = round;
+    step->peer = peer;
+    step->buf = buf;
+    step->count = count;
+    step->finished = false;
+}
+
+// The schedules below mirror the blocking algorithms and return the round following their last one.
+static int schedule_sync_up(request_t* req, const tree_links_t* links, int round) {
+    for (int i = 0; i < links->num_children; i++) {
+        schedule_add(req, STEP_RECV, round, links->children[i], req->tmp, sizeof(char));
+    }
+    if (links->parent != -1) { schedule_add(req, STEP_SEND, round + 1, links->parent, req->tmp, sizeof(char)); }
+    return round + 2;
+}
+
+static int schedule_sync_down(request_t* req, const tree_links_t* links, int round) {
+    if (links->parent != -1) { schedule_add(req, STEP_RECV, round, links->parent, req->tmp, sizeof(char)); }
+    for (int i = 0; i < links->num_children; i++) {
+        schedule_add(req, STEP_SEND, round + 1, links->children[i], req->tmp, sizeof(char));
+    }
+    return round + 2;
+}
+
+static void schedule_barrier(request_t* req) {
+    const comm_t* comm = req->comm;
+    const algorithm_t* algo = select_algorithm(COLL_BARRIER, comm->size, 0);
+    int round = 0;
+
+    req->tmp = calloc(1, sizeof(char));
+
+    if (algo->fn == dissemination_barrier) {
+        for (int dist = 1; dist < comm->size; dist <<= 1, round++) {
+            schedule_add(req, STEP_SEND, round, (comm->rank + dist) % comm->size, req->tmp, sizeof(char));
+            schedule_add(req, STEP_RECV, round, (comm->rank - dist + comm->size) % comm->size,
+                         req->tmp, sizeof(char));
+        }
+    } else {
+        round = schedule_sync_up(req, &comm->trees[algo->sync_shape][0], round);
+        schedule_sync_down(req, &comm->trees[algo->sync_shape][0], round);
+    }
+}
+
+static void schedule_bcast(request_t* req, u_int8_t* data, int count, int root) {
+    const comm_t* comm = req->comm;
+    const algorithm_t* algo = select_algorithm(COLL_BCAST, comm->size, count);
+    const tree_links_t* links = &comm->trees[algo->shape][root];
+    int segment = algo->pipelined ? MIMPI_SEGMENT_SIZE : count;
+    int offset = 0;
+    int round = 0;
+
+    req->tmp = calloc(1, sizeof(char));
+
+    if (comm->synchronizing) { round = schedule_sync_up(req, &comm->trees[algo->sync_shape][root], round); }
+
+    do {
+        int len = minimum(segment, count - offset);
+
+        if (links->parent != -1) { schedule_add(req, STEP_RECV, round, links->parent, data + offset, len); }
+        for (int i = 0; i < links->num_children; i++) {
+            schedule_add(req, STEP_SEND, round + 1, links->children[i], data + offset, len);
+        }
+
+        round += 2;
+        offset += len;
+    } while (offset < count);
+}
+
+static void schedule_reduce(request_t* req, void const* send_data, void* recv_data, int count, int root) {
+    const comm_t* comm = req->comm;
+    const algorithm_t* algo = select_algorithm(COLL_REDUCE, comm->size, count);
+    // Trees are chosen just like in tree_reduce.
+    tree_shape_t shape = (req->commutative || algo->shape != TREE_BINARY) ? algo->shape : TREE_BINOMIAL;
+    int tree_root = req->commutative ? root : 0;
+    const tree_links_t* links = &comm->trees[shape][tree_root];
+    int segment = reduce_segment(algo, count, req->op);
+    int offset = 0;
+    int round = 0;
+
+    // The result is combined in place if it stays in this process.
+    req->tmp = malloc(count + 1);
+    u_int8_t* res = (comm->rank == root && tree_root == root) ? recv_data : req->tmp + 1;
+    req->tmp[0] = '0';
+    memcpy(res, send_data, count);
+
+    do {
+        int len = minimum(segment, count - offset);
+
+        for (int i = links->num_children - 1; i >= 0; i--) { // In rank order.
+            schedule_add(req, STEP_RECV_REDUCE, round, links->children[i], res + offset, len);
+        }
+        if (links->parent != -1) { schedule_add(req, STEP_SEND, round + 1, links->parent, res + offset, len); }
+
+        round += 2;
+        offset += len;
+    } while (offset < count);
+
+    if (tree_root != root) {
+        if (comm->rank == tree_root) { schedule_add(req, STEP_SEND, round, root, res, count); }
+        if (comm->rank == root) { schedule_add(req, STEP_RECV, round, tree_root, recv_data, count); }
+        round++;
+    }
+
+    if (comm->synchronizing) { schedule_sync_down(req, &comm->trees[algo->sync_shape][root], round); }
+}
+
+// Never to be performed outside a mutex!!!
+static void request_complete(request_t* req, MIMPI_Retcode ret) {
+    req->done = true;
+    req->ret = ret;
+    free(req->steps);
+    free(req->tmp);
+    req->steps = NULL;
+    req->tmp = NULL;
+    ASSERT_ZERO(pthread_cond_broadcast(&g_request_done));
+}
+
+// Runs every step of the current round that can run now and moves on to the following rounds.
+// Returns whether anything has been done. Never to be performed outside a mutex!!!
+static bool request_progress(request_t* req) {
+    bool progressed = false;
+
+    while (!req->done) {
+        bool pending = false;
+        bool blocked = false; // Whether an earlier non-commutative combination is still pending.
+        int round = req->steps[req->first].round;
+
+        for (int i = req->first; i < req->num_steps && req->steps[i].round == round; i++) {
+            step_t* step = &req->steps[i];
+            int peer = req->comm->world_ranks[step->peer];
+            MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+            if (step->finished) continue;
+
+            if (step->kind == STEP_SEND) {
+                // Data is written without the mutex, so that the helpers keep receiving meanwhile.
+                ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+                ret = send_msg(step->buf, step->count, peer, req->tag, req->comm->context);
+                ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+            } else {
+                buffer_node_t* node = NULL;
+
+                connect_start(peer);
+                if (!(step->kind == STEP_RECV_REDUCE && blocked)) {
+                    node = find_and_unlink(step->count, peer, req->tag, req->comm->context);
+                }
+
+                if (node != NULL) {
+                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+                    if (step->kind == STEP_RECV) { memcpy(step->buf, node->data, step->count); }
+                    else { reduction(step->buf, node->data, step->count, req->op); }
+                    free_node(node);
+                    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+                } else if (!blocked && g_ended[peer]) {
+                    ret = MIMPI_ERROR_REMOTE_FINISHED;
+                } else {
+                    pending = true;
+                    if (step->kind == STEP_RECV_REDUCE && !req->commutative) { blocked = true; }
+                    continue;
+                }
+            }
+
+            step->finished = true;
+            progressed = true;
+
+            if (ret != MIMPI_SUCCESS) {
+                request_complete(req, ret);
+                return true;
+            }
+        }
+
+        if (pending) return progressed;
+
+        while (req->first < req->num_steps && req->steps[req->first].finished) {
+            req->first++;
+        }
+        if (req->first == req->num_steps) { request_complete(req, MIMPI_SUCCESS); }
+    }
+    return progressed;
+}
+
+static void* progress_main(void* data) {
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+    while (!g_progress_exit) {
+        bool progressed = false;
+        bool pending = false;
+
+        deliver_all();
+        for (int i = 0; i < MIMPI_MAX_REQUESTS; i++) {
+            if (g_requests[i].used && !g_requests[i].done) {
+                pending = true;
+                progressed |= request_progress(&g_requests[i]);
+            }
+        }
+
+        if (progressed) continue;
+
+        // Helpers wake the thread only while it waits for messages, see delivery_notify.
+        if (pending) { atomic_store(&g_progress_sleeping, true); }
+        if (!pending || !delivery_pending_any()) {
+            ASSERT_ZERO(pthread_cond_wait(&g_progress, &g_mutex));
+        }
+        atomic_store(&g_progress_sleeping, false);
+    }
+
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    uring_release();
+    return NULL;
+}
+
+// Hands the schedule over to the progress thread, which is started on the first use.
+static MIMPI_Request request_post(const request_t* req) {
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+    MIMPI_Request handle = 0;
+    while (handle < MIMPI_MAX_REQUESTS && g_requests[handle].used) {
+        handle++;
+    }
+    if (handle == MIMPI_MAX_REQUESTS) fatal("Too many pending non-blocking collectives (at most %d)", MIMPI_MAX_REQUESTS);
+
+    g_requests[handle] = *req;
+    if (req->num_steps == 0) { request_complete(&g_requests[handle], MIMPI_SUCCESS); }
+
+    if (!g_progress_started) {
+        g_progress_started = true;
+        ASSERT_ZERO(pthread_create(&g_progress_thread, NULL, progress_main, NULL));
+    }
+    ASSERT_ZERO(pthread_cond_signal(&g_progress));
+
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    return handle;
+}
+
+// Returns NULL if the handle does not refer to a request of this process.
+static request_t* request_get(MIMPI_Request handle) {
+    if (handle < 0 || handle >= MIMPI_MAX_REQUESTS || !g_requests[handle].used) return NULL;
+    return &g_requests[handle];
+}
+
+static void progress_finalize() {
+    if (!g_progress_started) return;
+
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+    g_progress_exit = true;
+    ASSERT_ZERO(pthread_cond_signal(&g_progress));
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+
+    ASSERT_ZERO(pthread_join(g_progress_thread, NULL));
+
+    for (int i = 0; i < MIMPI_MAX_REQUESTS; i++) {
+        free(g_requests[i].steps);
+        free(g_requests[i].tmp);
+    }
+}
+
+/* Library Function */
+void MIMPI_Init(bool enable_deadlock_detection) {
+    channels_init();
+
+    g_rank = atoi(getenv("MIMPI_rank"));
+    g_size = atoi(getenv("MIMPI_size"));
+    const char* stripes_str = getenv("MIMPI_stripes");
+    g_num_stripes = stripes_str ? atoi(stripes_str) : 1;
+    g_num_lanes = 1 + g_num_stripes;
+
+    int world_ranks[MIMPI_MAX_N];
+    for (int i = 0; i < g_size; i++) {
+        world_ranks[i] = i;
+    }
+    for (int i = 0; i < MIMPI_MAX_COMMS; i++) {
+        g_comms[i].used = false;
+    }
+    g_next_context = 0;
+    comm_setup(&g_comms[MIMPI_COMM_WORLD], g_next_context++, g_rank, g_size, world_ranks, true);
+    load_tuning();
+    reduction_pool_init();
+
+    ASSERT_ZERO(pthread_mutex_init(&g_mutex, NULL));
+    ASSERT_ZERO(pthread_cond_init(&g_on_recv, NULL));
+    spin_init();
+    ASSERT_ZERO(pthread_cond_init(&g_progress, NULL));
+    ASSERT_ZERO(pthread_cond_init(&g_request_done, NULL));
+    ASSERT_ZERO(pthread_cond_init(&g_connect, NULL));
+    for (int i = 0; i < g_size; i++) {
+        for (int lane = 0; lane < g_num_lanes; lane++) {
+            ASSERT_ZERO(pthread_mutex_init(&g_write_mutex[i][lane], NULL));
+            delivery_queue_init(&g_queues[i][lane]);
+            g_reassembly[i].num_read[lane] = 0;
+            g_reassembly[i].closed[lane] = false;
+        }
+        ASSERT_ZERO(pthread_mutex_init(&g_reassembly[i].mutex, NULL));
+        ASSERT_ZERO(pthread_cond_init(&g_reassembly[i].cond, NULL));
+        g_reassembly[i].buff = NULL;
+        g_reassembly[i].generation = 0;
+    }
+    for (int i = 0; i < MIMPI_MAX_REQUESTS; i++) {
+        g_requests[i].used = false;
+        g_requests[i].steps = NULL;
+        g_requests[i].tmp = NULL;
+    }
+    g_progress_started = false;
+    g_progress_exit = false;
+    g_source = -1;
+    g_deadlock_detection = enable_deadlock_detection;
+    g_first_node = new_node(0, 0, -1, 0, NULL);
+    g_last_node = new_node(0, 0, -1, 0, NULL);
+    g_first_node->next = g_last_node;
+    g_last_node->prev = g_first_node;
+    for (int i = 0; i < g_size; i++) {
+        g_alive[i] = true;
+        g_is_waiting_on_recv[i] = false;
+        g_num_sent[i] = 0;
+        g_num_recv[i] = 0;
+        g_num_delivered[i] = 0;
+        g_ended[i] = false;
+        g_lanes_ended[i] = 0;
+        g_connect_requested[i] = false;
+        g_connected[i] = false;
+        g_has_helper[i] = false;
+    }
+
+    // Channels and their helpers are set up on first use.
+    ASSERT_ZERO(pthread_create(&g_listener, NULL, listener_main, NULL));
+
+    const char* uring_str = getenv("MIMPI_URING");
+    g_uring_enabled = uring_str && atoi(uring_str) > 0;
+    ASSERT_ZERO(pthread_mutex_init(&g_urings_mutex, NULL));
+    for (int i = 0; i < MIMPI_MAX_URINGS; i++) {
+        g_urings[i] = NULL;
+    }
+
+    const char* compress_str = getenv("MIMPI_COMPRESS");
+    g_compress_threshold = compress_str ? atoi(compress_str) : 0;
+    atomic_init(&g_compress_raw, 0);
+    atomic_init(&g_compress_sent, 0);
+
+    const char* autotune_path = getenv("MIMPI_AUTOTUNE");
+    if (autotune_path) autotune(autotune_path);
+}
+
+void MIMPI_Finalize() {
+    progress_finalize();
+
+    // After the answer no more channels get passed, so the set of helpers is final.
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+    rendezvous_send(MIMPI_RENDEZVOUS_FD, RENDEZVOUS_FINALIZE, -1, NULL, 0);
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    ASSERT_ZERO(pthread_join(g_listener, NULL));
+    ASSERT_SYS_OK(close(MIMPI_RENDEZVOUS_FD));
+
+    uring_release();
     ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
 
-    g_num_sent[destination]++;
-    g_is_waiting_on_recv[destination] = false;
+    g_alive[g_rank] = false;
+    for (int i = 0; i < g_size; i++) {
+        for (int lane = 0; g_has_helper[i] && lane < g_num_lanes; lane++) {
+            if (g_write_open[i][lane]) {
+                uring_forget(write_fd(i, lane));
+                ASSERT_SYS_OK(close(write_fd(i, lane)));
+                g_write_open[i][lane] = false;
+            }
+        }
+    }
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+
+    for (int i = 0; i < g_size; i++) {
+        if (g_has_helper[i]) {
+            for (int lane = 0; lane < g_num_lanes; lane++) {
+                ASSERT_ZERO(pthread_join(thread[i][lane], NULL));
+            }
+        }
+    }
+    deliver_all(); // So that cleanup frees the messages nobody has received.
+
+    reduction_pool_finalize();
+    cleanup();
+    channels_finalize();
+}
+
+int MIMPI_World_size() {
+    return g_size;
+}
+
+int MIMPI_World_rank() {
+    return g_rank;
+}
+
+long long MIMPI_Pooled_reduction_bytes() {
+    return atomic_load(&g_pool_bytes);
+}
+
+double MIMPI_Compression_ratio() {
+    long long sent = atomic_load(&g_compress_sent);
+    return (sent == 0) ? 1.0 : (double) atomic_load(&g_compress_raw) / sent;
+}
+
+MIMPI_Retcode MIMPI_Send(
+        void const* data,
+        int count,
+        int destination,
+        int tag
+) {
+    return MIMPI_Comm_send(data, count, destination, tag, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Recv(
+        void* data,
+        int count,
+        int source,
+        int tag
+) {
+    return MIMPI_Comm_recv(data, count, source, tag, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Barrier() {
+    return comm_barrier(&g_comms[MIMPI_COMM_WORLD]);
+}
+
+MIMPI_Retcode MIMPI_Bcast(
+        void* data,
+        int count,
+        int root
+) {
+    return comm_bcast(&g_comms[MIMPI_COMM_WORLD], data, count, root);
+}
+
+MIMPI_Retcode MIMPI_Reduce(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Op op,
+        int root
+) {
+    return comm_reduce(&g_comms[MIMPI_COMM_WORLD], send_data, recv_data, count, op, root);
+}
+
+MIMPI_Retcode MIMPI_Comm_split(
+        MIMPI_Comm comm,
+        int color,
+        int key,
+        MIMPI_Comm* newcomm
+) {
+    const comm_t* parent_comm = comm_get(comm);
+    if (parent_comm == NULL) return MIMPI_ERROR_INVALID_COMM;
+
+    int handle = -1;
+    if (color != MIMPI_UNDEFINED) {
+        for (int i = 0; i < MIMPI_MAX_COMMS && handle == -1; i++) {
+            if (!g_comms[i].used) handle = i;
+        }
+        if (handle == -1) fatal("Too many communicators (at most %d).", MIMPI_MAX_COMMS);
+    }
+
+    int info[MIMPI_MAX_N * 3]; // (color, key, next context) of every member.
+    info[parent_comm->rank * 3] = color;
+    info[parent_comm->rank * 3 + 1] = key;
+    info[parent_comm->rank * 3 + 2] = g_next_context;
+
+    MIMPI_Retcode ret = exchange_split_info(parent_comm, info);
+    if (ret != MIMPI_SUCCESS) return ret;
+
+    // The context has to be unused by every member, so the largest proposal is taken.
+    int context = g_next_context;
+    for (int i = 0; i < parent_comm->size; i++) {
+        if (info[i * 3 + 2] > context) context = info[i * 3 + 2];
+    }
+    g_next_context = context + 1;
+
+    if (color == MIMPI_UNDEFINED) {
+        *newcomm = MIMPI_COMM_NULL;
+        return MIMPI_SUCCESS;
+    }
+
+    // Members are ordered by key, ties are broken by the rank in the parent.
+    int members[MIMPI_MAX_N];
+    int size = 0;
+    int rank = 0;
+    for (int i = 0; i < parent_comm->size; i++) {
+        if (info[i * 3] != color) continue;
+
+        int j = size++;
+        while (j > 0 && info[members[j - 1] * 3 + 1] > info[i * 3 + 1]) {
+            members[j] = members[j - 1];
+            j--;
+        }
+        members[j] = i;
+    }
+
+    int world_ranks[MIMPI_MAX_N];
+    for (int i = 0; i < size; i++) {
+        world_ranks[i] = parent_comm->world_ranks[members[i]];
+        if (members[i] == parent_comm->rank) rank = i;
+    }
+
+    comm_setup(&g_comms[handle], context, rank, size, world_ranks, parent_comm->synchronizing);
+    *newcomm = handle;
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Comm_dup(MIMPI_Comm comm, MIMPI_Comm* newcomm) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+
+    MIMPI_Retcode ret = MIMPI_Comm_split(comm, 0, c->rank, newcomm);
+    if (ret != MIMPI_SUCCESS || !c->has_topology) return ret;
+
+    topology_setup(&g_comms[*newcomm], c->indegree, c->sources, c->outdegree, c->destinations);
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Dist_graph_create_adjacent(
+        MIMPI_Comm comm,
+        int indegree,
+        const int* sources,
+        int outdegree,
+        const int* destinations,
+        MIMPI_Comm* newcomm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    MIMPI_Retcode check = topology_check(indegree, sources, c);
+    if (check == MIMPI_SUCCESS) check = topology_check(outdegree, destinations, c);
 
-    bool ret = thorough_write(mt, data, count,
-                             MIMPI_WRITE_OFFSET + MIMPI_MAX_N * rank + destination,
-                             destination);
+    // Every process takes part in the split, a process with invalid neighbours staying out of it,
+    // so that the others see it by the size of the new communicator instead of waiting for it.
+    MIMPI_Retcode ret = MIMPI_Comm_split(comm, (check == MIMPI_SUCCESS) ? 0 : MIMPI_UNDEFINED, c->rank, newcomm);
+    if (ret != MIMPI_SUCCESS) return ret;
+    if (check != MIMPI_SUCCESS) return check;
+    if (g_comms[*newcomm].size != c->size) {
+        MIMPI_Comm_free(newcomm);
+        return MIMPI_ERROR_INVALID_TOPOLOGY;
+    }
 
-    if (!ret) { return MIMPI_ERROR_REMOTE_FINISHED; }
-    else { return MIMPI_SUCCESS; }
+    topology_setup(&g_comms[*newcomm], indegree, sources, outdegree, destinations);
+    return MIMPI_SUCCESS;
 }
 
-MIMPI_Retcode MIMPI_Recv(
+MIMPI_Retcode MIMPI_Comm_free(MIMPI_Comm* comm) {
+    comm_t* c = comm_get(*comm);
+    if (c == NULL || *comm == MIMPI_COMM_WORLD) return MIMPI_ERROR_INVALID_COMM;
+
+    c->used = false;
+    *comm = MIMPI_COMM_NULL;
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Comm_set_synchronizing(MIMPI_Comm comm, bool synchronizing) {
+    comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+
+    c->synchronizing = synchronizing;
+    return MIMPI_SUCCESS;
+}
+
+int MIMPI_Comm_size(MIMPI_Comm comm) {
+    const comm_t* c = comm_get(comm);
+    return (c == NULL) ? -1 : c->size;
+}
+
+int MIMPI_Comm_rank(MIMPI_Comm comm) {
+    const comm_t* c = comm_get(comm);
+    return (c == NULL) ? -1 : c->rank;
+}
+
+MIMPI_Retcode MIMPI_Comm_send(
+        void const* data,
+        int count,
+        int destination,
+        int tag,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+    if (destination == c->rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+    if (destination < 0 || destination >= c->size) return MIMPI_ERROR_NO_SUCH_RANK;
+
+    return comm_send(c, data, count, destination, tag);
+}
+
+MIMPI_Retcode MIMPI_Comm_recv(
         void* data,
         int count,
         int source,
-        int tag
+        int tag,
+        MIMPI_Comm comm
 ) {
-    int rank = MIMPI_World_rank();
-    int recv;
-    int sent;
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+    if (source == c->rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+    if (source < 0 || source >= c->size) return MIMPI_ERROR_NO_SUCH_RANK;
 
-    if (source == rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
-    if (source < 0 || source >= MIMPI_World_size()) return MIMPI_ERROR_NO_SUCH_RANK;
+    return comm_recv(c, data, count, source, tag);
+}
 
-    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+MIMPI_Retcode MIMPI_Comm_barrier(MIMPI_Comm comm) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-    if (!find_and_delete(data, count, source, tag)) {
-        if (!g_alive[source]) {
-            ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    return comm_barrier(c);
+}
 
-        if (g_is_waiting_on_recv[source] &&
-            g_num_sent_to_me[source] == g_num_recv[source]) { // There is a deadlock.
+MIMPI_Retcode MIMPI_Comm_bcast(
+        void* data,
+        int count,
+        int root,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-            g_is_waiting_on_recv[source] = false; // The other process will also detect a deadlock.
-            recv = g_num_recv[source];
-            sent = g_num_sent[source];
+    return comm_bcast(c, data, count, root);
+}
 
-            ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+MIMPI_Retcode MIMPI_Comm_reduce(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Op op,
+        int root,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-            send_waiting(source, recv, sent);
-            return MIMPI_ERROR_DEADLOCK_DETECTED;
-        }
+    return comm_reduce(c, send_data, recv_data, count, op, root);
+}
+
+MIMPI_Retcode MIMPI_Allgather(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-        // Give the helpers info about what to look for.
-        g_source = source;
-        g_tag = tag;
-        g_count = count;
+    return comm_allgather(c, send_data, recv_data, count);
+}
 
-        recv = g_num_recv[source];
-        sent = g_num_sent[source];
+MIMPI_Retcode MIMPI_Alltoall(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+    return comm_alltoall(c, send_data, recv_data, count);
+}
 
-        send_waiting(source, recv, sent);
+MIMPI_Retcode MIMPI_Gather(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        int root,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-        while (true) {
-            ASSERT_SYS_OK(pthread_mutex_lock(&g_on_recv));
-            // Critical section inheritance
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .count = count,
+                              .root = root, .send_count = count};
+    return comm_gather(c, &args);
+}
 
-            switch(g_recv_sig) {
-                case MESSAGE_ARRIVED:
-                    g_source = -1;
-                    memcpy(data, g_last_node->prev->data, count);
-                    del_node(g_last_node->prev);
-                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
-                    return MIMPI_SUCCESS;
-                case PROCESS_ENDED:
-                    g_source = -1;
-                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
-                    return MIMPI_ERROR_REMOTE_FINISHED;
-                case DEADLOCK_DETECTED_BY_BOTH_SIDES:
-                    g_source = -1;
-                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
-                    return MIMPI_ERROR_DEADLOCK_DETECTED;
-                case DEADLOCK_DETECTED_BY_ONE_SIDE:
-                    recv = g_num_recv[source];
-                    sent = g_num_sent[source];
+MIMPI_Retcode MIMPI_Gatherv(
+        void const* send_data,
+        int send_count,
+        void* recv_data,
+        const int* recv_counts,
+        const int* displs,
+        int root,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-                    g_source = -1;
-                    g_is_waiting_on_recv[source] = false;
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .root = root,
+                              .send_count = send_count, .variable = true,
+                              .counts = recv_counts, .displs = displs};
+    return comm_gather(c, &args);
+}
 
-                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+MIMPI_Retcode MIMPI_Scatter(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        int root,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-                    send_waiting(source, recv, sent);
-                    return MIMPI_ERROR_DEADLOCK_DETECTED;
-                case RETRY_SENDING_WAITING:
-                    recv = g_num_recv[source];
-                    sent = g_num_sent[source];
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .count = count,
+                              .root = root, .recv_count = count};
+    return comm_scatter(c, &args);
+}
 
-                    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+MIMPI_Retcode MIMPI_Scatterv(
+        void const* send_data,
+        const int* send_counts,
+        const int* displs,
+        void* recv_data,
+        int recv_count,
+        int root,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
 
-                    send_waiting(source, recv, sent);
-                    break;
-            }
+    // The count is left at 0, like in Gatherv, as the algorithm has to be the same on every process.
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .root = root,
+                              .recv_count = recv_count, .variable = true,
+                              .counts = send_counts, .displs = displs};
+    return comm_scatter(c, &args);
+}
+
+MIMPI_Retcode MIMPI_Op_create(
+        MIMPI_User_function fn,
+        int elem_size,
+        bool commutative,
+        MIMPI_Op* op
+) {
+    if (fn == NULL || elem_size <= 0) return MIMPI_ERROR_INVALID_OP;
+
+    for (int i = 0; i < MIMPI_MAX_USER_OPS; i++) {
+        if (!g_ops[i].used) {
+            g_ops[i].used = true;
+            g_ops[i].fn = fn;
+            g_ops[i].elem_size = elem_size;
+            g_ops[i].commutative = commutative;
+            *op = MIMPI_OP_USER_FIRST + i;
+            return MIMPI_SUCCESS;
         }
     }
-    else {
+    fatal("Too many operations (at most %d).", MIMPI_MAX_USER_OPS);
+}
+
+MIMPI_Retcode MIMPI_Op_free(MIMPI_Op* op) {
+    if (user_op_get(*op) == NULL) return MIMPI_ERROR_INVALID_OP;
+
+    g_ops[*op - MIMPI_OP_USER_FIRST].used = false;
+    *op = MIMPI_OP_NULL;
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Scan(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Op op,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .count = count, .op = op};
+    return comm_scan(c, &args);
+}
+
+MIMPI_Retcode MIMPI_Exscan(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Op op,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+
+    collective_args_t args = {.send_data = send_data, .recv_data = recv_data, .count = count, .op = op,
+                              .exclusive = true};
+    return comm_scan(c, &args);
+}
+
+MIMPI_Retcode MIMPI_Sendrecv(
+        void const* send_data,
+        int send_count,
+        int destination,
+        int send_tag,
+        void* recv_data,
+        int recv_count,
+        int source,
+        int recv_tag,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+    if (destination == c->rank || source == c->rank) return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+    if (destination < 0 || destination >= c->size) return MIMPI_ERROR_NO_SUCH_RANK;
+    if (source < 0 || source >= c->size) return MIMPI_ERROR_NO_SUCH_RANK;
+
+    // Helpers receive the incoming message while the outgoing one is being written,
+    // so sending first cannot deadlock even if the peer does the same.
+    MIMPI_Retcode ret = comm_send(c, send_data, send_count, destination, send_tag);
+    if (ret != MIMPI_SUCCESS) return ret;
+
+    return comm_recv(c, recv_data, recv_count, source, recv_tag);
+}
+
+MIMPI_Retcode MIMPI_Sendrecv_replace(
+        void* data,
+        int count,
+        int destination,
+        int send_tag,
+        int source,
+        int recv_tag,
+        MIMPI_Comm comm
+) {
+    // The outgoing data are written out before any incoming data are copied to the buffer.
+    return MIMPI_Sendrecv(data, count, destination, send_tag, data, count, source, recv_tag, comm);
+}
+
+MIMPI_Retcode MIMPI_Ibarrier(MIMPI_Comm comm, MIMPI_Request* request) {
+    comm_t* c = comm_get(comm);
+    *request = MIMPI_REQUEST_NULL;
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+
+    request_t req;
+    request_init(&req, c, MIMPI_SUM);
+    schedule_barrier(&req);
+    *request = request_post(&req);
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Ibcast(
+        void* data,
+        int count,
+        int root,
+        MIMPI_Comm comm,
+        MIMPI_Request* request
+) {
+    comm_t* c = comm_get(comm);
+    *request = MIMPI_REQUEST_NULL;
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+    if (root < 0 || root >= c->size) return MIMPI_ERROR_NO_SUCH_RANK;
+
+    request_t req;
+    request_init(&req, c, MIMPI_SUM);
+    schedule_bcast(&req, data, count, root);
+    *request = request_post(&req);
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Ireduce(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Op op,
+        int root,
+        MIMPI_Comm comm,
+        MIMPI_Request* request
+) {
+    comm_t* c = comm_get(comm);
+    *request = MIMPI_REQUEST_NULL;
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+    if (root < 0 || root >= c->size) return MIMPI_ERROR_NO_SUCH_RANK;
+    if (!op_valid(op) || count % op_elem_size(op) != 0) return MIMPI_ERROR_INVALID_OP;
+
+    request_t req;
+    request_init(&req, c, op);
+    schedule_reduce(&req, send_data, recv_data, count, root);
+    *request = request_post(&req);
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Wait(MIMPI_Request* request) {
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
+
+    request_t* req = request_get(*request);
+    if (req == NULL) {
         ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
-        return MIMPI_SUCCESS;
+        return MIMPI_ERROR_INVALID_REQUEST;
+    }
+
+    while (!req->done) {
+        ASSERT_ZERO(pthread_cond_wait(&g_request_done, &g_mutex));
     }
+    MIMPI_Retcode ret = req->ret;
+    req->used = false;
+
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+
+    *request = MIMPI_REQUEST_NULL;
+    return ret;
 }
 
-MIMPI_Retcode MIMPI_Barrier() {
-    MIMPI_Retcode ret;
-    int rank = MIMPI_World_rank();
-    int l = left_child(rank);
-    int r = right_child(rank);
-    // If rank is the root of the tree, there will be garbage in p, but it won't be used.
-    int p = parent(rank);
-    char* dummy = malloc(sizeof(char));
-    *dummy = '0'; // Initializing the data to avoid valgrind errors.
+MIMPI_Retcode MIMPI_Test(MIMPI_Request* request, bool* flag) {
+    ASSERT_SYS_OK(pthread_mutex_lock(&g_mutex));
 
-    if (has_left_child(rank)) {
-        ret = MIMPI_Recv(dummy, sizeof(char), l, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    request_t* req = request_get(*request);
+    if (req == NULL) {
+        ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
+        return MIMPI_ERROR_INVALID_REQUEST;
     }
 
-    if (has_right_child(rank)) {
-        ret = MIMPI_Recv(dummy, sizeof(char), r, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+    *flag = req->done;
+    if (req->done) {
+        ret = req->ret;
+        req->used = false;
     }
 
-    if (!is_root(rank)) {
-        ret = MIMPI_Send(dummy, sizeof(char), p, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    ASSERT_SYS_OK(pthread_mutex_unlock(&g_mutex));
 
-        ret = MIMPI_Recv(dummy, sizeof(char), p, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
-    }
+    if (*flag) { *request = MIMPI_REQUEST_NULL; }
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Neighbor_allgather(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+    if (!c->has_topology) return MIMPI_ERROR_INVALID_TOPOLOGY;
+
+    return neighbor_exchange(c, send_data, 0, recv_data, count);
+}
+
+MIMPI_Retcode MIMPI_Neighbor_alltoall(
+        void const* send_data,
+        void* recv_data,
+        int count,
+        MIMPI_Comm comm
+) {
+    const comm_t* c = comm_get(comm);
+    if (c == NULL) return MIMPI_ERROR_INVALID_COMM;
+    if (!c->has_topology) return MIMPI_ERROR_INVALID_TOPOLOGY;
+
+    return neighbor_exchange(c, send_data, count, recv_data, count);
+}
+
+/* One-sided Communication */
+// Returns NULL if the handle does not refer to a window of this process.
+static window_t* win_get(MIMPI_Win handle) {
+    if (handle < 0 || handle >= MIMPI_MAX_WINDOWS || !g_windows[handle].used) return NULL;
+    return &g_windows[handle];
+}
+
+static size_t win_align(size_t size) {
+    return (size + MIMPI_WIN_ALIGN - 1) / MIMPI_WIN_ALIGN * MIMPI_WIN_ALIGN;
+}
+
+// Finds the count bytes at disp of the region of rank, if they fit in it.
+static MIMPI_Retcode win_target(const window_t* win, int rank, int disp, int count, u_int8_t** target) {
+    const comm_t* c = comm_get(win->comm);
 
-    if (has_left_child(rank)) {
-        ret = MIMPI_Send(dummy, sizeof(char), l, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    if (rank < 0 || rank >= c->size) return MIMPI_ERROR_NO_SUCH_RANK;
+    if (disp < 0 || count < 0 || (long long) disp + count > win->sizes[rank]) return MIMPI_ERROR_INVALID_WIN;
+
+    *target = win->regions[rank] + disp;
+    return MIMPI_SUCCESS;
+}
+
+// Sets up the locks of a fresh window. They live in memory shared by processes, hence the attributes.
+static void win_shared_init(win_shared_t* shared) {
+    pthread_rwlockattr_t rwlock_attr;
+    pthread_mutexattr_t mutex_attr;
+
+    ASSERT_ZERO(pthread_rwlockattr_init(&rwlock_attr));
+    ASSERT_ZERO(pthread_rwlockattr_setpshared(&rwlock_attr, PTHREAD_PROCESS_SHARED));
+    ASSERT_ZERO(pthread_mutexattr_init(&mutex_attr));
+    ASSERT_ZERO(pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED));
+    for (int i = 0; i < MIMPI_MAX_N; i++) {
+        ASSERT_ZERO(pthread_rwlock_init(&shared->locks[i], &rwlock_attr));
+        ASSERT_ZERO(pthread_mutex_init(&shared->atomics[i], &mutex_attr));
     }
+    ASSERT_ZERO(pthread_rwlockattr_destroy(&rwlock_attr));
+    ASSERT_ZERO(pthread_mutexattr_destroy(&mutex_attr));
+}
 
-    if (has_right_child(rank)) {
-        ret = MIMPI_Send(dummy, sizeof(char), r, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+// Maps the shared memory of a window, creating it first if asked to.
+static void* win_map(const char* name, size_t size, bool create) {
+    int fd;
+
+    if (create) {
+        ASSERT_SYS_OK(fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600));
+        ASSERT_SYS_OK(ftruncate(fd, (off_t) size));
+    } else {
+        ASSERT_SYS_OK(fd = shm_open(name, O_RDWR, 0));
     }
 
-    free(dummy);
-    return MIMPI_SUCCESS;
+    void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) syserr("Cannot map %s", name);
+    ASSERT_SYS_OK(close(fd));
+    return mem;
 }
 
-MIMPI_Retcode MIMPI_Bcast(
-        void* data,
-        int count,
-        int root
+MIMPI_Retcode MIMPI_Win_create(
+        int size,
+        MIMPI_Comm comm,
+        void** base,
+        MIMPI_Win* win
 ) {
-    int ret;
-    int rank = rank_adjust(MIMPI_World_rank(), root);
-    int l = rank_adjust(left_child(rank), root);
-    int r = rank_adjust(right_child(rank), root);
-    // If rank is the root of the tree, there will be garbage in p, but it won't be used.
-    int p = rank_adjust(parent(rank), root);
-    char* dummy = malloc(sizeof(char));
-    *dummy = '0'; // Initializing the data to avoid valgrind errors.
+    if (comm_get(comm) == NULL) return MIMPI_ERROR_INVALID_COMM;
+    if (size < 0) return MIMPI_ERROR_INVALID_WIN;
+
+    int handle = -1;
+    for (int i = 0; i < MIMPI_MAX_WINDOWS && handle == -1; i++) {
+        if (!g_windows[i].used) handle = i;
+    }
+    if (handle == -1) fatal("Too many windows (at most %d).", MIMPI_MAX_WINDOWS);
+
+    // The window gets a communicator of its own, whose context names its memory and keeps
+    // its fences apart from the collectives of comm.
+    window_t* w = &g_windows[handle];
+    MIMPI_Retcode ret = MIMPI_Comm_dup(comm, &w->comm);
+    if (ret != MIMPI_SUCCESS) return ret;
 
-    if (has_left_child(rank)) {
-        ret = MIMPI_Recv(dummy, sizeof(char), l, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    const comm_t* c = comm_get(w->comm);
+    ret = comm_allgather(c, &size, w->sizes, sizeof(int));
+    if (ret != MIMPI_SUCCESS) {
+        MIMPI_Comm_free(&w->comm);
+        return ret;
     }
 
-    if (has_right_child(rank)) {
-        ret = MIMPI_Recv(dummy, sizeof(char), r, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    size_t offsets[MIMPI_MAX_N];
+    w->mapped_size = win_align(sizeof(win_shared_t));
+    for (int i = 0; i < c->size; i++) {
+        offsets[i] = w->mapped_size;
+        w->mapped_size += win_align(w->sizes[i]);
     }
 
-    if (!is_root(rank)) {
-        ret = MIMPI_Send(dummy, sizeof(char), p, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    // All processes are children of mimpirun, so its pid keeps names of different runs apart.
+    char name[64];
+    snprintf(name, sizeof(name), "/mimpi-%d-%d-%d", (int) getppid(), c->world_ranks[0], c->context);
 
-        ret = MIMPI_Recv(data, count, p, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    void* mem = NULL;
+    if (c->rank == 0) {
+        mem = win_map(name, w->mapped_size, true);
+        win_shared_init(mem);
     }
 
-    if (has_left_child(rank)) {
-        ret = MIMPI_Send(data, count, l, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    // Others open the memory once it is set up, and it is unlinked once all of them have,
+    // so that it goes away with the last mapping.
+    ret = comm_barrier(c);
+    if (ret == MIMPI_SUCCESS && c->rank != 0) mem = win_map(name, w->mapped_size, false);
+    if (ret == MIMPI_SUCCESS) ret = comm_barrier(c);
+    if (c->rank == 0) ASSERT_SYS_OK(shm_unlink(name));
+
+    if (ret != MIMPI_SUCCESS) {
+        if (mem != NULL) ASSERT_SYS_OK(munmap(mem, w->mapped_size));
+        MIMPI_Comm_free(&w->comm);
+        return ret;
     }
 
-    if (has_right_child(rank)) {
-        ret = MIMPI_Send(data, count, r, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, NULL, NULL);
+    w->used = true;
+    w->shared = mem;
+    for (int i = 0; i < c->size; i++) {
+        w->regions[i] = (u_int8_t*) mem + offsets[i];
+        w->held[i] = -1;
     }
+    *base = w->regions[c->rank];
+    *win = handle;
+    return MIMPI_SUCCESS;
+}
 
-    free(dummy);
+MIMPI_Retcode MIMPI_Win_free(MIMPI_Win* win) {
+    window_t* w = win_get(*win);
+    if (w == NULL) return MIMPI_ERROR_INVALID_WIN;
+
+    const comm_t* c = comm_get(w->comm);
+    for (int i = 0; i < c->size; i++) {
+        if (w->held[i] != -1) ASSERT_ZERO(pthread_rwlock_unlock(&w->shared->locks[i]));
+    }
+
+    // Nobody accesses the memory any more once everybody has got here.
+    MIMPI_Retcode ret = comm_barrier(c);
+
+    ASSERT_SYS_OK(munmap(w->shared, w->mapped_size));
+    MIMPI_Comm_free(&w->comm);
+    w->used = false;
+    *win = MIMPI_WIN_NULL;
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Put(
+        void const* data,
+        int count,
+        int target_rank,
+        int target_disp,
+        MIMPI_Win win
+) {
+    const window_t* w = win_get(win);
+    if (w == NULL) return MIMPI_ERROR_INVALID_WIN;
+
+    u_int8_t* target;
+    MIMPI_Retcode ret = win_target(w, target_rank, target_disp, count, &target);
+    if (ret != MIMPI_SUCCESS) return ret;
+
+    memcpy(target, data, count);
     return MIMPI_SUCCESS;
 }
 
-MIMPI_Retcode MIMPI_Reduce(
-        void const* send_data,
-        void* recv_data,
+MIMPI_Retcode MIMPI_Get(
+        void* data,
+        int count,
+        int target_rank,
+        int target_disp,
+        MIMPI_Win win
+) {
+    const window_t* w = win_get(win);
+    if (w == NULL) return MIMPI_ERROR_INVALID_WIN;
+
+    u_int8_t* target;
+    MIMPI_Retcode ret = win_target(w, target_rank, target_disp, count, &target);
+    if (ret != MIMPI_SUCCESS) return ret;
+
+    memcpy(data, target, count);
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Accumulate(
+        void const* data,
         int count,
+        int target_rank,
+        int target_disp,
         MIMPI_Op op,
-        int root
+        MIMPI_Win win
 ) {
-    int ret;
-    int rank = rank_adjust(MIMPI_World_rank(), root);
-    int l = rank_adjust(left_child(rank), root);
-    int r = rank_adjust(right_child(rank), root);
-    // If rank is the root of the tree, there will be garbage in p, but it won't be used.
-    int p = rank_adjust(parent(rank), root);
-    char* dummy = malloc(sizeof(char));
-    *dummy = '0'; // Initializing the data to avoid valgrind errors.
-    u_int8_t* res = malloc(count);
-    u_int8_t* buf = malloc(count);
-    memcpy(res, send_data, count);
+    const window_t* w = win_get(win);
+    if (w == NULL) return MIMPI_ERROR_INVALID_WIN;
+    if (!op_valid(op) || count % op_elem_size(op) != 0) return MIMPI_ERROR_INVALID_OP;
 
-    if (has_left_child(rank)) {
-        ret = MIMPI_Recv(buf, count, l, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, res, buf);
-        reduction(res, buf, count, op);
-    }
+    u_int8_t* target;
+    MIMPI_Retcode ret = win_target(w, target_rank, target_disp, count, &target);
+    if (ret != MIMPI_SUCCESS) return ret;
 
-    if (has_right_child(rank)) {
-        ret = MIMPI_Recv(buf, count, r, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, res, buf);
-        reduction(res, buf, count, op);
-    }
+    ASSERT_ZERO(pthread_mutex_lock(&w->shared->atomics[target_rank]));
+    reduction(target, data, count, op);
+    ASSERT_ZERO(pthread_mutex_unlock(&w->shared->atomics[target_rank]));
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Fetch_and_op(
+        void const* data,
+        void* result,
+        int target_rank,
+        int target_disp,
+        MIMPI_Op op,
+        MIMPI_Win win
+) {
+    const window_t* w = win_get(win);
+    if (w == NULL) return MIMPI_ERROR_INVALID_WIN;
+    if (!op_valid(op)) return MIMPI_ERROR_INVALID_OP;
 
-    if (!is_root(rank)) {
-        ret = MIMPI_Send(res, count, p, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, res, buf);
+    int count = op_elem_size(op);
+    u_int8_t* target;
+    MIMPI_Retcode ret = win_target(w, target_rank, target_disp, count, &target);
+    if (ret != MIMPI_SUCCESS) return ret;
 
-        ret = MIMPI_Recv(dummy, sizeof(char), p, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, res, buf);
-    } else {
-        memcpy(recv_data, res, count);
-    }
+    ASSERT_ZERO(pthread_mutex_lock(&w->shared->atomics[target_rank]));
+    memcpy(result, target, count);
+    reduction(target, data, count, op);
+    ASSERT_ZERO(pthread_mutex_unlock(&w->shared->atomics[target_rank]));
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Win_fence(MIMPI_Win win) {
+    const window_t* w = win_get(win);
+    if (w == NULL) return MIMPI_ERROR_INVALID_WIN;
+
+    // Writes to the memory made before are visible to whoever gets past the barrier.
+    atomic_thread_fence(memory_order_seq_cst);
+    return comm_barrier(comm_get(w->comm));
+}
 
-    if (has_left_child(rank)) {
-        ret = MIMPI_Send(dummy, sizeof(char), l, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, res, buf);
+MIMPI_Retcode MIMPI_Win_lock(
+        MIMPI_Lock_type lock_type,
+        int rank,
+        MIMPI_Win win
+) {
+    window_t* w = win_get(win);
+    if (w == NULL) return MIMPI_ERROR_INVALID_WIN;
+    if (rank < 0 || rank >= comm_get(w->comm)->size) return MIMPI_ERROR_NO_SUCH_RANK;
+    if ((lock_type != MIMPI_LOCK_EXCLUSIVE && lock_type != MIMPI_LOCK_SHARED) || w->held[rank] != -1) {
+        return MIMPI_ERROR_INVALID_WIN;
     }
 
-    if (has_right_child(rank)) {
-        ret = MIMPI_Send(dummy, sizeof(char), r, -1);
-        CHECK_IF_REMOTE_FINISHED(ret, dummy, res, buf);
+    if (lock_type == MIMPI_LOCK_EXCLUSIVE) {
+        ASSERT_ZERO(pthread_rwlock_wrlock(&w->shared->locks[rank]));
+    } else {
+        ASSERT_ZERO(pthread_rwlock_rdlock(&w->shared->locks[rank]));
     }
+    w->held[rank] = lock_type;
+    return MIMPI_SUCCESS;
+}
 
-    free(dummy);
-    free(res);
-    free(buf);
+MIMPI_Retcode MIMPI_Win_unlock(
+        int rank,
+        MIMPI_Win win
+) {
+    window_t* w = win_get(win);
+    if (w == NULL) return MIMPI_ERROR_INVALID_WIN;
+    if (rank < 0 || rank >= comm_get(w->comm)->size) return MIMPI_ERROR_NO_SUCH_RANK;
+    if (w->held[rank] == -1) return MIMPI_ERROR_INVALID_WIN;
+
+    ASSERT_ZERO(pthread_rwlock_unlock(&w->shared->locks[rank]));
+    w->held[rank] = -1;
     return MIMPI_SUCCESS;
 }
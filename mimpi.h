@@ -5,6 +5,32 @@
 
 #define MIMPI_ANY_TAG 0
 
+/// @brief Handle of a communicator.
+///
+/// A communicator is a group of processes with its own rank numbering.
+/// Messages and collective operations of different communicators never mix.
+typedef int MIMPI_Comm;
+
+#define MIMPI_COMM_WORLD 0 /// communicator of all processes launched by `mimpirun`
+#define MIMPI_COMM_NULL (-1) /// handle that does not refer to any communicator
+#define MIMPI_UNDEFINED (-1) /// color of processes not joining any communicator in @ref MIMPI_Comm_split()
+
+/// @brief Handle of a pending non-blocking collective operation.
+typedef int MIMPI_Request;
+
+#define MIMPI_REQUEST_NULL (-1) /// handle that does not refer to any request
+
+/// @brief Handle of a window of memory for one-sided communication.
+typedef int MIMPI_Win;
+
+#define MIMPI_WIN_NULL (-1) /// handle that does not refer to any window
+
+/// Kind of a lock taken with @ref MIMPI_Win_lock().
+typedef enum {
+    MIMPI_LOCK_EXCLUSIVE = 0, /// no other process holds a lock of the region at the same time
+    MIMPI_LOCK_SHARED = 1, /// other processes may hold shared locks of the region at the same time
+} MIMPI_Lock_type;
+
 /// Return code of MIMPI operations.
 typedef enum {
     MIMPI_SUCCESS = 0, /// operation ended successfully
@@ -12,18 +38,33 @@ typedef enum {
     MIMPI_ERROR_NO_SUCH_RANK = 2, /// no process with requested rank exists in the world
     MIMPI_ERROR_REMOTE_FINISHED = 3, /// the remote process involved in communication has finished
     MIMPI_ERROR_DEADLOCK_DETECTED = 4, /// a deadlock has been detected
+    MIMPI_ERROR_INVALID_COMM = 5, /// the communicator handle does not refer to any communicator
+    MIMPI_ERROR_INVALID_OP = 6, /// the operation handle does not refer to any operation or does not fit the data
+    MIMPI_ERROR_INVALID_REQUEST = 7, /// the request handle does not refer to any pending request
+    MIMPI_ERROR_INVALID_TOPOLOGY = 8, /// the communicator has no neighbours declared or too many of them
+    MIMPI_ERROR_INVALID_WIN = 9, /// the window handle does not refer to any window, or the access does not fit it
 } MIMPI_Retcode;
 
 /// @brief Reduction operation kind.
 ///
 /// Type of operation performed in @ref MIMPI_Reduce().
+/// Built-in operations work on single bytes. Other operations
+/// can be created with @ref MIMPI_Op_create().
 typedef enum {
+    MIMPI_OP_NULL = -1, /// handle that does not refer to any operation
     MIMPI_MAX,
     MIMPI_MIN,
     MIMPI_SUM,
     MIMPI_PROD,
 } MIMPI_Op;
 
+/// @brief User-defined reduction operation.
+///
+/// Combines @ref count consecutive elements at @ref in into
+/// the ones at @ref inout, i.e. sets `inout[i] = inout[i] op in[i]`.
+/// Called on whole blocks of elements, so it can be vectorised.
+typedef void (*MIMPI_User_function)(void const *in, void *inout, int count);
+
 /// @brief Initialises MIMPI framework in MIMPI programs.
 ///
 /// Opens an _MPI block_, permitting use of other MIMPI procedures.
@@ -51,6 +92,22 @@ int MIMPI_World_size();
 ///
 int MIMPI_World_rank();
 
+/// @brief Returns how well the messages sent by this process have compressed.
+///
+/// Messages of at least `MIMPI_COMPRESS` bytes, if that environment variable
+/// is set, go compressed whenever that makes them smaller. The result is
+/// their total size divided by the number of bytes actually sent for them,
+/// or 1.0 if there were no such messages.
+///
+double MIMPI_Compression_ratio();
+
+/// @brief Returns how many bytes of reductions this process has combined on its pool of threads.
+///
+/// The pool has `MIMPI_REDUCTION_THREADS` threads, if that environment variable
+/// is set, and takes combines of at least 256 KiB. The result is 0 without it.
+///
+long long MIMPI_Pooled_reduction_bytes();
+
 /// @brief Sends data to the specified process.
 ///
 /// Sends @ref count bytes of @ref data to the process with rank @ref destination.
@@ -162,6 +219,8 @@ MIMPI_Retcode MIMPI_Bcast(
 ///         - `MIMPI_SUCCESS` if operation ended successfully.
 ///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
 ///           @ref root in the world.
+///         - `MIMPI_ERROR_INVALID_OP` if @ref op is not an operation or
+///           @ref count is not a multiple of its element size.
 ///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in the world
 ///            has already escaped _MPI block_.
 ///         - `MIMPI_ERROR_DEADLOCK_DETECTED` if a deadlock has been detected
@@ -175,4 +234,682 @@ MIMPI_Retcode MIMPI_Reduce(
     int root
 );
 
+/// @brief Creates a reduction operation.
+///
+/// The operation can be used wherever built-in ones can; then the number
+/// of bytes of data has to be a multiple of @ref elem_size.
+/// For a commutative operation the library may combine the data of
+/// processes in any order (e.g. the order they arrive in). Otherwise the
+/// result is `x_0 op x_1 op ... op x_(n-1)` for data `x_i` of process with rank i.
+/// Must be called with the same @ref commutative flag in every process using it.
+///
+/// @param fn - function combining blocks of elements.
+/// @param elem_size - size of a single element in bytes.
+/// @param commutative - whether the operation is commutative.
+/// @param op - place where the handle of the new operation is to be put.
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_OP` if @ref fn is NULL or @ref elem_size is not positive.
+///
+MIMPI_Retcode MIMPI_Op_create(
+    MIMPI_User_function fn,
+    int elem_size,
+    bool commutative,
+    MIMPI_Op *op
+);
+
+/// @brief Frees an operation created by @ref MIMPI_Op_create() and sets @ref op to `MIMPI_OP_NULL`.
+MIMPI_Retcode MIMPI_Op_free(MIMPI_Op *op);
+
+/// @brief Splits a communicator into disjoint sub-communicators.
+///
+/// Must be called by every process of @ref comm. Processes passing the same
+/// @ref color end up in the same new communicator, where they are ranked
+/// by @ref key (ties are broken by the rank in @ref comm).
+///
+/// @param comm - communicator to be split.
+/// @param color - selects the new communicator; `MIMPI_UNDEFINED` if
+///                the process is not to join any of them.
+/// @param key - controls the rank of the process in the new communicator.
+/// @param newcomm - place where the handle of the new communicator is to be put
+///                  (`MIMPI_COMM_NULL` for `MIMPI_UNDEFINED` @ref color).
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Comm_split(
+    MIMPI_Comm comm,
+    int color,
+    int key,
+    MIMPI_Comm *newcomm
+);
+
+/// @brief Duplicates a communicator.
+///
+/// The new communicator has the same processes and ranks as @ref comm,
+/// but its messages never mix with the ones of @ref comm.
+/// Must be called by every process of @ref comm.
+///
+MIMPI_Retcode MIMPI_Comm_dup(
+    MIMPI_Comm comm,
+    MIMPI_Comm *newcomm
+);
+
+/// @brief Frees a communicator created by this process.
+///
+/// Sets @ref comm to `MIMPI_COMM_NULL`. `MIMPI_COMM_WORLD` cannot be freed.
+///
+MIMPI_Retcode MIMPI_Comm_free(MIMPI_Comm *comm);
+
+/// @brief Decides whether broadcast and reduce in @ref comm are synchronisation points.
+///
+/// By default @ref MIMPI_Bcast() and @ref MIMPI_Reduce() (and their
+/// `MIMPI_Comm_` counterparts) act as barriers, which costs an additional
+/// wave of messages through the whole communicator. With @ref synchronizing
+/// set to false they send only the data: a process may leave the broadcast
+/// as soon as it has the data and the reduce as soon as it has passed on
+/// its partial result. Must be set to the same value in every process of
+/// @ref comm. Communicators created from @ref comm inherit the setting.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///
+MIMPI_Retcode MIMPI_Comm_set_synchronizing(MIMPI_Comm comm, bool synchronizing);
+
+/// @brief Returns the number of processes in @ref comm (-1 if it is not a communicator).
+int MIMPI_Comm_size(MIMPI_Comm comm);
+
+/// @brief Returns the rank of this process in @ref comm (-1 if it is not a communicator).
+int MIMPI_Comm_rank(MIMPI_Comm comm);
+
+/// @brief Works like @ref MIMPI_Send() with @ref destination being a rank in @ref comm.
+MIMPI_Retcode MIMPI_Comm_send(
+    void const *data,
+    int count,
+    int destination,
+    int tag,
+    MIMPI_Comm comm
+);
+
+/// @brief Works like @ref MIMPI_Recv() with @ref source being a rank in @ref comm.
+MIMPI_Retcode MIMPI_Comm_recv(
+    void *data,
+    int count,
+    int source,
+    int tag,
+    MIMPI_Comm comm
+);
+
+/// @brief Works like @ref MIMPI_Barrier() over the processes of @ref comm only.
+MIMPI_Retcode MIMPI_Comm_barrier(MIMPI_Comm comm);
+
+/// @brief Works like @ref MIMPI_Bcast() over the processes of @ref comm only.
+MIMPI_Retcode MIMPI_Comm_bcast(
+    void *data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief Works like @ref MIMPI_Reduce() over the processes of @ref comm only.
+MIMPI_Retcode MIMPI_Comm_reduce(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief Gathers data from all processes of a communicator in all of them.
+///
+/// Puts @ref count bytes of data at address @ref send_data in process
+/// with rank i in @ref comm at address @ref recv_data + i * @ref count
+/// in every process of @ref comm.
+///
+/// @param send_data - data of this process.
+/// @param recv_data - place where the data of all processes are to be put
+///                    (@ref count times size of @ref comm bytes).
+/// @param count - number of bytes of data of a single process.
+/// @param comm - communicator whose processes exchange the data.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Allgather(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+);
+
+/// @brief Exchanges distinct data between every pair of processes of a communicator.
+///
+/// Puts @ref count bytes of data at address @ref send_data + j * @ref count
+/// in process with rank i in @ref comm at address @ref recv_data + i * @ref count
+/// in process with rank j.
+///
+/// @param send_data - data for every process (@ref count times size of @ref comm bytes).
+/// @param recv_data - place where the data from every process are to be put
+///                    (@ref count times size of @ref comm bytes).
+/// @param count - number of bytes of data sent to a single process.
+/// @param comm - communicator whose processes exchange the data.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Alltoall(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+);
+
+/// @brief Gathers data from all processes of a communicator in one of them.
+///
+/// Puts @ref count bytes of data at address @ref send_data in process
+/// with rank i in @ref comm at address @ref recv_data + i * @ref count
+/// in process @ref root. Blocks travel along a binomial tree, so the root
+/// receives a logarithmic number of messages.
+///
+/// @param send_data - data of this process.
+/// @param recv_data - place where the data of all processes are to be put
+///                    (@ref count times size of @ref comm bytes);
+///                    significant only in @ref root.
+/// @param count - number of bytes of data of a single process.
+/// @param root - rank in @ref comm of the process gathering the data.
+/// @param comm - communicator whose processes take part.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref root in @ref comm.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Gather(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief Works like @ref MIMPI_Gather() with blocks of different sizes.
+///
+/// Process with rank i in @ref comm passes @ref send_count equal to
+/// @ref recv_counts[i], and its data are put at address
+/// @ref recv_data + @ref displs[i] in process @ref root.
+/// @ref recv_counts and @ref displs are significant only in @ref root.
+///
+MIMPI_Retcode MIMPI_Gatherv(
+    void const *send_data,
+    int send_count,
+    void *recv_data,
+    const int *recv_counts,
+    const int *displs,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief Scatters data from one process among all processes of a communicator.
+///
+/// Puts @ref count bytes of data at address @ref send_data + i * @ref count
+/// in process @ref root at address @ref recv_data in process with rank i
+/// in @ref comm. Blocks travel along a binomial tree, so the root sends
+/// a logarithmic number of messages.
+///
+/// @param send_data - data for every process (@ref count times size of @ref comm bytes);
+///                    significant only in @ref root.
+/// @param recv_data - place where the data for this process are to be put.
+/// @param count - number of bytes of data for a single process.
+/// @param root - rank in @ref comm of the process scattering the data.
+/// @param comm - communicator whose processes take part.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref root in @ref comm.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Scatter(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief Works like @ref MIMPI_Scatter() with blocks of different sizes.
+///
+/// Process with rank i in @ref comm gets @ref send_counts[i] bytes from
+/// address @ref send_data + @ref displs[i] in process @ref root and passes
+/// @ref recv_count equal to @ref send_counts[i].
+/// @ref send_counts and @ref displs are significant only in @ref root.
+///
+MIMPI_Retcode MIMPI_Scatterv(
+    void const *send_data,
+    const int *send_counts,
+    const int *displs,
+    void *recv_data,
+    int recv_count,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief Computes prefix reductions over the processes of a communicator.
+///
+/// Puts at @ref recv_data in process with rank i in @ref comm the reduction
+/// of kind @ref op over @ref count bytes of data at @ref send_data in processes
+/// with ranks 0, 1, ..., i (in this order for non-commutative operations).
+/// Takes ceil(log2(n)) rounds of messages for n processes.
+///
+/// @param send_data - data of this process.
+/// @param recv_data - place where the prefix reduction is to be put.
+/// @param count - number of bytes of data to be reduced.
+/// @param op - a particular operation to be performed for reduction.
+/// @param comm - communicator whose processes take part.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_INVALID_OP` if @ref op is not an operation or
+///           @ref count is not a multiple of its element size.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Scan(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op,
+    MIMPI_Comm comm
+);
+
+/// @brief Works like @ref MIMPI_Scan() without the data of the process itself.
+///
+/// Process with rank i gets the reduction over ranks 0, 1, ..., i - 1.
+/// @ref recv_data in process with rank 0 is left untouched.
+///
+MIMPI_Retcode MIMPI_Exscan(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op,
+    MIMPI_Comm comm
+);
+
+/// @brief Sends data to one process and receives data from another one.
+///
+/// Works like @ref MIMPI_Comm_send() of @ref send_count bytes of @ref send_data
+/// to @ref destination tagged with @ref send_tag together with
+/// @ref MIMPI_Comm_recv() of @ref recv_count bytes to @ref recv_data from
+/// @ref source tagged with @ref recv_tag, both in @ref comm.
+/// The exchange never deadlocks, no matter how the peers order their calls
+/// (e.g. all processes of a ring may call it at once), and the incoming message
+/// is received while the outgoing one is being sent.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_ATTEMPTED_SELF_OP` if @ref destination or @ref source
+///           is this process.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref destination or @ref source in @ref comm.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if @ref destination or @ref source
+///           has already escaped _MPI block_.
+///         - `MIMPI_ERROR_DEADLOCK_DETECTED` if a deadlock has been detected
+///           while receiving.
+///
+MIMPI_Retcode MIMPI_Sendrecv(
+    void const *send_data,
+    int send_count,
+    int destination,
+    int send_tag,
+    void *recv_data,
+    int recv_count,
+    int source,
+    int recv_tag,
+    MIMPI_Comm comm
+);
+
+/// @brief Works like @ref MIMPI_Sendrecv() with a single buffer
+/// @ref data of @ref count bytes, which is sent and then overwritten.
+MIMPI_Retcode MIMPI_Sendrecv_replace(
+    void *data,
+    int count,
+    int destination,
+    int send_tag,
+    int source,
+    int recv_tag,
+    MIMPI_Comm comm
+);
+
+/// @brief Creates a communicator with a declared graph of neighbours.
+///
+/// The new communicator has the same processes and ranks as @ref comm.
+/// Each process declares the processes it receives from (@ref sources)
+/// and sends to (@ref destinations) in neighbourhood collectives, which
+/// must agree across processes: if j is among the destinations of i,
+/// then i is among the sources of j, as many times.
+/// Must be called by every process of @ref comm.
+///
+/// @param comm - communicator to be extended with the graph.
+/// @param indegree - number of sources, at most 32.
+/// @param sources - ranks in @ref comm of the sources.
+/// @param outdegree - number of destinations, at most 32.
+/// @param destinations - ranks in @ref comm of the destinations.
+/// @param newcomm - place where the handle of the new communicator is to be put.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_ATTEMPTED_SELF_OP` if the process is its own neighbour.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           of a neighbour in @ref comm.
+///         - `MIMPI_ERROR_INVALID_TOPOLOGY` if there are too many neighbours,
+///           or another process has given invalid neighbours.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Dist_graph_create_adjacent(
+    MIMPI_Comm comm,
+    int indegree,
+    const int *sources,
+    int outdegree,
+    const int *destinations,
+    MIMPI_Comm *newcomm
+);
+
+/// @brief Gathers data from the sources of this process.
+///
+/// Sends @ref count bytes of @ref send_data to every destination and puts
+/// the data of the i-th source at @ref recv_data + i * @ref count.
+/// Messages to and from all neighbours are in flight at the same time.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_INVALID_TOPOLOGY` if @ref comm has no graph of neighbours.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any neighbour
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Neighbor_allgather(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+);
+
+/// @brief Works like @ref MIMPI_Neighbor_allgather() with a separate block
+/// for every destination.
+///
+/// The i-th destination gets @ref count bytes at @ref send_data + i * @ref count.
+///
+MIMPI_Retcode MIMPI_Neighbor_alltoall(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+);
+
+/// @brief Starts a barrier without waiting for it to complete.
+///
+/// The barrier, like every non-blocking collective, is carried out in
+/// the background while the process goes on with its work, and is completed
+/// with @ref MIMPI_Wait() or @ref MIMPI_Test() on the handle put at
+/// @ref request. Processes of a communicator have to start collectives,
+/// blocking and non-blocking, in the same order.
+/// Errors of the operation itself are reported when completing it.
+///
+/// @param comm - communicator whose processes take part.
+/// @param request - place where the handle of the operation is to be put.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation has been started successfully.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///
+MIMPI_Retcode MIMPI_Ibarrier(
+    MIMPI_Comm comm,
+    MIMPI_Request *request
+);
+
+/// @brief Works like @ref MIMPI_Comm_bcast() without waiting for the broadcast to complete.
+///
+/// @ref data must not be accessed until the operation is completed.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation has been started successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref root in @ref comm.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///
+MIMPI_Retcode MIMPI_Ibcast(
+    void *data,
+    int count,
+    int root,
+    MIMPI_Comm comm,
+    MIMPI_Request *request
+);
+
+/// @brief Works like @ref MIMPI_Comm_reduce() without waiting for the reduction to complete.
+///
+/// @ref send_data may be reused right away, while @ref recv_data must not be
+/// accessed until the operation is completed.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation has been started successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref root in @ref comm.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_INVALID_OP` if @ref op is not an operation or
+///           @ref count is not a multiple of its element size.
+///
+MIMPI_Retcode MIMPI_Ireduce(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op,
+    int root,
+    MIMPI_Comm comm,
+    MIMPI_Request *request
+);
+
+/// @brief Waits for a non-blocking collective to complete.
+///
+/// Sets @ref request to `MIMPI_REQUEST_NULL` when the operation is completed.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_REQUEST` if @ref request is not a pending request.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process taking part in
+///            the operation has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Wait(
+    MIMPI_Request *request
+);
+
+/// @brief Checks whether a non-blocking collective has completed, without waiting.
+///
+/// Puts the answer at @ref flag. If the operation has completed, works
+/// like @ref MIMPI_Wait(); otherwise returns `MIMPI_SUCCESS`.
+MIMPI_Retcode MIMPI_Test(
+    MIMPI_Request *request,
+    bool *flag
+);
+
+/// @brief Creates a window, exposing a region of memory of every process of a communicator to the others.
+///
+/// All processes of @ref comm have to call it, in the same order as their
+/// collectives. The region of @ref size bytes is allocated by MIMPI in memory
+/// shared by all of them, as they run on one host, and put at @ref base.
+/// Other processes access it with @ref MIMPI_Put(), @ref MIMPI_Get(),
+/// @ref MIMPI_Accumulate() and @ref MIMPI_Fetch_and_op(), which never
+/// involve the process owning it, while the process itself may access it directly.
+/// The accesses are synchronised with @ref MIMPI_Win_fence(), or
+/// @ref MIMPI_Win_lock() and @ref MIMPI_Win_unlock().
+///
+/// @param size - size of the region of this process, which may differ between processes.
+/// @param comm - communicator whose processes expose their regions.
+/// @param base - place where the address of the region is to be put.
+/// @param win - place where the handle of the window is to be put.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_COMM` if @ref comm is not a communicator.
+///         - `MIMPI_ERROR_INVALID_WIN` if @ref size is negative.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///           has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Win_create(
+    int size,
+    MIMPI_Comm comm,
+    void **base,
+    MIMPI_Win *win
+);
+
+/// @brief Frees the window, once every process of its communicator has called it.
+///
+/// Sets @ref win to `MIMPI_WIN_NULL`. Holds of locks of the window are given up.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_WIN` if @ref win is not a window.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process of the window
+///           has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Win_free(MIMPI_Win *win);
+
+/// @brief Writes @ref count bytes of @ref data at offset @ref target_disp of the region of @ref target_rank.
+///
+/// @ref target_rank is a rank in the communicator of the window and may be
+/// the rank of the calling process. The data is in place when the call returns,
+/// and visible to the target after the next synchronisation.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref target_rank in the communicator of the window.
+///         - `MIMPI_ERROR_INVALID_WIN` if @ref win is not a window or
+///           the data does not fit in the region.
+///
+MIMPI_Retcode MIMPI_Put(
+    void const *data,
+    int count,
+    int target_rank,
+    int target_disp,
+    MIMPI_Win win
+);
+
+/// @brief Reads @ref count bytes at offset @ref target_disp of the region of @ref target_rank into @ref data.
+///
+/// @return MIMPI return code like @ref MIMPI_Put().
+///
+MIMPI_Retcode MIMPI_Get(
+    void *data,
+    int count,
+    int target_rank,
+    int target_disp,
+    MIMPI_Win win
+);
+
+/// @brief Combines @ref count bytes of @ref data into the region of @ref target_rank at offset @ref target_disp.
+///
+/// Sets every element `t` of the target to `t op d`, where `d` is the corresponding
+/// element of @ref data. Accumulates and fetch-and-ops on a region are atomic
+/// with respect to each other, also when issued by different processes
+/// with no lock held.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref target_rank in the communicator of the window.
+///         - `MIMPI_ERROR_INVALID_OP` if @ref op is not an operation or
+///           @ref count is not a multiple of its element size.
+///         - `MIMPI_ERROR_INVALID_WIN` if @ref win is not a window or
+///           the data does not fit in the region.
+///
+MIMPI_Retcode MIMPI_Accumulate(
+    void const *data,
+    int count,
+    int target_rank,
+    int target_disp,
+    MIMPI_Op op,
+    MIMPI_Win win
+);
+
+/// @brief Atomically puts the element at offset @ref target_disp of the region of @ref target_rank
+/// at @ref result and combines @ref data into it, like @ref MIMPI_Accumulate().
+///
+/// Works on a single element of @ref op, a byte for built-in operations.
+///
+/// @return MIMPI return code like @ref MIMPI_Accumulate().
+///
+MIMPI_Retcode MIMPI_Fetch_and_op(
+    void const *data,
+    void *result,
+    int target_rank,
+    int target_disp,
+    MIMPI_Op op,
+    MIMPI_Win win
+);
+
+/// @brief Separates epochs of accesses to the window, for all processes of its communicator.
+///
+/// Once every process has called it, accesses any of them has made before
+/// are visible to all of them. Works like a barrier of the communicator of the window.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_INVALID_WIN` if @ref win is not a window.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process of the window
+///           has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Win_fence(MIMPI_Win win);
+
+/// @brief Waits until the process may access the region of @ref rank under a lock of @ref lock_type.
+///
+/// The owner of the region takes no part in it. A process holds at most one lock
+/// of a region at a time. Accesses made under the lock are visible to the next
+/// process locking the region.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref rank in the communicator of the window.
+///         - `MIMPI_ERROR_INVALID_WIN` if @ref win is not a window, @ref lock_type
+///           is not a kind of lock or the process already holds a lock of the region.
+///
+MIMPI_Retcode MIMPI_Win_lock(
+    MIMPI_Lock_type lock_type,
+    int rank,
+    MIMPI_Win win
+);
+
+/// @brief Gives up the lock of the region of @ref rank taken with @ref MIMPI_Win_lock().
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref rank in the communicator of the window.
+///         - `MIMPI_ERROR_INVALID_WIN` if @ref win is not a window
+///           or the process holds no lock of the region.
+///
+MIMPI_Retcode MIMPI_Win_unlock(
+    int rank,
+    MIMPI_Win win
+);
+
 #endif /* MIMPI_H */
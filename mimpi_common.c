@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -44,3 +45,57 @@ _Noreturn void fatal(const char* fmt, ...)
 /////////////////////////////////////////////////
 // Put your implementation here
 
+bool rendezvous_send(int sock, rendezvous_type_t type, int peer, const int* fds, int num_fds)
+{
+    rendezvous_msg_t msg = {.type = type, .peer = peer};
+    struct iovec iov = {.iov_base = &msg, .iov_len = sizeof(msg)};
+    union {
+        char buf[CMSG_SPACE(MIMPI_RENDEZVOUS_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr hdr = {.msg_iov = &iov, .msg_iovlen = 1};
+
+    assert(num_fds <= MIMPI_RENDEZVOUS_MAX_FDS);
+    if (num_fds > 0) {
+        hdr.msg_control = control.buf;
+        hdr.msg_controllen = CMSG_SPACE(num_fds * sizeof(int));
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(num_fds * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, num_fds * sizeof(int));
+    }
+
+    ssize_t ret = sendmsg(sock, &hdr, MSG_NOSIGNAL);
+    if (ret == -1 && (errno == EPIPE || errno == ECONNRESET)) return false;
+    ASSERT_SYS_OK(ret);
+    return true;
+}
+
+int rendezvous_recv(int sock, rendezvous_msg_t* msg, int* fds)
+{
+    struct iovec iov = {.iov_base = msg, .iov_len = sizeof(*msg)};
+    union {
+        char buf[CMSG_SPACE(MIMPI_RENDEZVOUS_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr hdr = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf,
+                         .msg_controllen = sizeof(control.buf)};
+
+    ssize_t ret;
+    do {
+        ret = recvmsg(sock, &hdr, 0);
+    } while (ret == -1 && errno == EINTR);
+    if (ret == 0 || (ret == -1 && errno == ECONNRESET)) return -1;
+    ASSERT_SYS_OK(ret);
+
+    int num_fds = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), num_fds * sizeof(int));
+        }
+    }
+    return num_fds;
+}
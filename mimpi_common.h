@@ -61,10 +61,65 @@ _Noreturn extern void fatal(const char* fmt, ...);
 // Offsets:
 #define MIMPI_READ_OFFSET 20
 #define MIMPI_WRITE_OFFSET 500
+#define MIMPI_CONTROL_READ_OFFSET 280 // A process only holds its own control lanes, so the peer alone tells them apart.
+#define MIMPI_CONTROL_WRITE_OFFSET 300
+#define MIMPI_RENDEZVOUS_FD 400 // Socket to mimpirun, between the read and the write channels.
+#define MIMPI_STRIPE_READ_OFFSET 404 // Lanes of the stripes past the first, MIMPI_MAX_N descriptors per stripe.
+#define MIMPI_STRIPE_WRITE_OFFSET (MIMPI_STRIPE_READ_OFFSET + (MIMPI_MAX_STRIPES - 1) * MIMPI_MAX_N) // Up to 499.
+#define MIMPI_SCRATCH_FD_MIN (MIMPI_WRITE_OFFSET + MIMPI_MAX_N * MIMPI_MAX_N) // Above every channel.
 
 // Misc:
 #define MIMPI_MAX_N 16
+#define MIMPI_MAX_COMMS 64
+#define MIMPI_MAX_TREE_CHILDREN 4 // log2(MIMPI_MAX_N) children of the root of a binomial tree.
+#define MIMPI_MAX_TUNING_ENTRIES 64
+#define MIMPI_AUTOTUNE_REPS 3
+#define MIMPI_MAX_REDUCTION_THREADS 16
+#define MIMPI_MAX_USER_OPS 32
+#define MIMPI_MAX_REQUESTS 64
+#define MIMPI_MAX_WINDOWS 16
+#define MIMPI_WIN_ALIGN 64 // Regions of a window start on cache lines of their own.
+#define MIMPI_MAX_NEIGHBORS (2 * MIMPI_MAX_N)
+#define MIMPI_MAX_SPIN 16384 // Checks of a waiting receive before it sleeps, a few microseconds.
+#define MIMPI_DELIVERY_QUEUE_SIZE 256 // Events per ring between a helper and the receiving side, a power of two.
+#define MIMPI_REDUCTION_CHUNK (64 * 1024) // Fits in L2 cache together with its counterpart.
+#define MIMPI_PARALLEL_REDUCTION_MIN (256 * 1024)
+#define MIMPI_MAX_STRIPES 4 // Data channels each way between two processes, see mimpirun --stripes.
+#define MIMPI_MAX_LANES (1 + MIMPI_MAX_STRIPES) // Channels each way, the data ones and one for control.
+#define MIMPI_STRIPE_MIN_COUNT (256 * 1024) // Smaller messages are not worth the threads sending the stripes.
+#define MIMPI_STRIPE_ALIGN 4096
+#define MIMPI_CONTROL_MAX_COUNT 64 // Messages of at most that many bytes go on the control lane.
 #define MIMPI_READ_BUFFER_SIZE 512
 #define MIMPI_WRITE_BUFFER_SIZE 4096
+#define MIMPI_URING_ENTRIES 16 // Frames written by a thread in one batch, at most one write of each in flight.
+#define MIMPI_URING_SLOT (MIMPI_WRITE_BUFFER_SIZE / MIMPI_URING_ENTRIES) // Room for a frame in the registered buffer.
+#define MIMPI_MAX_URINGS 8 // Threads writing with io_uring at the same time, the others write with syscalls.
+
+// Channels are set up on first use. A process asks mimpirun for them through its rendezvous
+// socket and mimpirun passes both ends of the channels to and from the peer to both processes.
+typedef enum {
+    RENDEZVOUS_CONNECT = 0, // Process asks for channels with peer.
+    RENDEZVOUS_FINALIZE = 1, // Process will not take any more channels.
+    RENDEZVOUS_CHANNELS = 2, // Read and write descriptors of the channels with peer are attached, lane by lane.
+    RENDEZVOUS_FINISHED = 3, // Peer has already finished, so there will be no channels with it.
+    RENDEZVOUS_BYE = 4 // Answer to RENDEZVOUS_FINALIZE, the last message to the process.
+
+} rendezvous_type_t;
+
+typedef struct rendezvous_msg
+{
+    rendezvous_type_t type;
+    int peer;
+
+} rendezvous_msg_t;
+
+#define MIMPI_RENDEZVOUS_MAX_FDS (2 * MIMPI_MAX_LANES)
+
+/* Sends the message with num_fds descriptors attached. Returns false if the other side has closed the socket. */
+extern bool rendezvous_send(int sock, rendezvous_type_t type, int peer, const int* fds, int num_fds);
+
+/* Receives a message and puts the attached descriptors in fds.
+   Returns the number of descriptors, or -1 if the other side has closed the socket. */
+extern int rendezvous_recv(int sock, rendezvous_msg_t* msg, int* fds);
 
 #endif // MIMPI_COMMON_H
\ No newline at end of file
@@ -2,42 +2,530 @@
  * This file is for implementation of mimpirun program.
  * */
 
+#define _GNU_SOURCE // For CPU affinity.
 #include "mimpi_common.h"
 #include "channel.h"
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <linux/mempolicy.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 #define READ 0
 #define WRITE 1
 
- void open_channel(int read_dsc, int write_dsc) {
-     int channel_dsc[2];
-     int new_dsc;
+#define MAX_NODES 64 // NUMA nodes fitting in a single mask.
 
-     ASSERT_SYS_OK(channel(channel_dsc));
+typedef enum {
+    BIND_NONE = 0,
+    BIND_CORE = 1, // Consecutive ranks go to consecutive cores.
+    BIND_SOCKET = 2 // Consecutive ranks fill sockets one after another.
 
-     // Check if current write descriptor and future read descriptor collide.
-     if (channel_dsc[WRITE] == read_dsc) {
-         new_dsc = dup(channel_dsc[WRITE]);
-         ASSERT_SYS_OK(new_dsc);
-         ASSERT_SYS_OK(close(channel_dsc[WRITE]));
-         channel_dsc[WRITE] = new_dsc;
-     }
+} bind_t;
 
-     if (channel_dsc[READ] != read_dsc) {
-         ASSERT_SYS_OK(dup2(channel_dsc[READ], read_dsc));
-         ASSERT_SYS_OK(close(channel_dsc[READ]));
-     }
+// Placement of the processes. Threads of a process inherit its binding and memory policy,
+// so helpers stay next to their rank.
+static bind_t g_bind = BIND_NONE;
+static int g_cpu_list[CPU_SETSIZE]; // Rank k runs on g_cpu_list[k % g_cpu_list_len] if given.
+static int g_cpu_list_len;
+static int g_mem_policy = MPOL_DEFAULT;
 
-     if (channel_dsc[WRITE] != write_dsc) {
-         ASSERT_SYS_OK(dup2(channel_dsc[WRITE], write_dsc));
-         ASSERT_SYS_OK(close(channel_dsc[WRITE]));
-     }
+// Topology of the CPUs mimpirun may run on.
+static int g_num_cpus;
+static int g_cpus[CPU_SETSIZE];
+static int g_package[CPU_SETSIZE];
+static int g_core[CPU_SETSIZE]; // Index of the core, unique across packages.
+static int g_node[CPU_SETSIZE];
+
+typedef struct rank_stats
+{
+    pid_t pid;
+    struct timespec start;
+    struct timespec end;
+    int status; // As returned by wait4.
+    struct rusage usage;
+
+} rank_stats_t;
+
+typedef enum {
+    METRIC_WALL = 0,
+    METRIC_USER = 1,
+    METRIC_SYSTEM = 2,
+    METRIC_MAX_RSS = 3,
+    METRIC_VOLUNTARY = 4,
+    METRIC_INVOLUNTARY = 5,
+    NUM_METRICS = 6
+
+} metric_t;
+
+static const char* const g_metric_names[NUM_METRICS] = {
+    [METRIC_WALL] = "wall_time_s",
+    [METRIC_USER] = "user_cpu_s",
+    [METRIC_SYSTEM] = "system_cpu_s",
+    [METRIC_MAX_RSS] = "max_rss_kib",
+    [METRIC_VOLUNTARY] = "voluntary_ctx_switches",
+    [METRIC_INVOLUNTARY] = "involuntary_ctx_switches",
+};
+
+static rank_stats_t g_stats[MIMPI_MAX_N];
+static int g_running;
+static bool g_report;
+static const char* g_report_json; // Path of the JSON report, if any.
+
+// State of the rendezvous with the processes.
+static int g_n;
+static int g_active; // Processes which may still ask for channels.
+static struct pollfd g_sockets[MIMPI_MAX_N + 1]; // fd is -1 once the process has finished.
+                                                  // g_sockets[g_n] is a signalfd for SIGCHLD.
+static bool g_connected[MIMPI_MAX_N][MIMPI_MAX_N];
+static int g_stripes = 1; // Data channels each way between two processes.
+
+static void finish(int k) {
+    ASSERT_SYS_OK(close(g_sockets[k].fd));
+    g_sockets[k].fd = -1;
+    g_active--;
+}
+
+// Passes the ends of the channels between k and j to both of them, or tells k that j is gone.
+static void connect_pair(int k, int j) {
+    if (j < 0 || j >= g_n || j == k || g_connected[k][j]) return;
+
+    g_connected[k][j] = g_connected[j][k] = true;
+
+    if (g_sockets[j].fd == -1) {
+        rendezvous_send(g_sockets[k].fd, RENDEZVOUS_FINISHED, j, NULL, 0);
+        return;
+    }
+
+    int k_to_j[MIMPI_MAX_LANES][2];
+    int j_to_k[MIMPI_MAX_LANES][2];
+    int j_fds[MIMPI_RENDEZVOUS_MAX_FDS];
+    int k_fds[MIMPI_RENDEZVOUS_MAX_FDS];
+    const int num_lanes = 1 + g_stripes;
+
+    for (int lane = 0; lane < num_lanes; lane++) {
+        ASSERT_SYS_OK(channel(k_to_j[lane]));
+        ASSERT_SYS_OK(channel(j_to_k[lane]));
+
+        j_fds[2 * lane] = k_to_j[lane][READ];
+        j_fds[2 * lane + 1] = j_to_k[lane][WRITE];
+        k_fds[2 * lane] = j_to_k[lane][READ];
+        k_fds[2 * lane + 1] = k_to_j[lane][WRITE];
+    }
+
+    if (rendezvous_send(g_sockets[j].fd, RENDEZVOUS_CHANNELS, k, j_fds, 2 * num_lanes)) {
+        rendezvous_send(g_sockets[k].fd, RENDEZVOUS_CHANNELS, j, k_fds, 2 * num_lanes);
+    } else {
+        finish(j);
+        rendezvous_send(g_sockets[k].fd, RENDEZVOUS_FINISHED, j, NULL, 0);
+    }
+
+    for (int lane = 0; lane < num_lanes; lane++) {
+        for (int i = 0; i < 2; i++) {
+            ASSERT_SYS_OK(close(k_to_j[lane][i]));
+            ASSERT_SYS_OK(close(j_to_k[lane][i]));
+        }
+    }
+}
+
+// Collects the status and resource usage of every process that has exited.
+static void reap() {
+    pid_t pid;
+    int status;
+    struct rusage usage;
+
+    while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+        for (int k = 0; k < g_n; k++) {
+            if (g_stats[k].pid != pid) continue;
+
+            ASSERT_SYS_OK(clock_gettime(CLOCK_MONOTONIC, &g_stats[k].end));
+            g_stats[k].status = status;
+            g_stats[k].usage = usage;
+            g_running--;
+        }
+    }
+    if (pid == -1 && errno != ECHILD) syserr("wait4");
+}
+
+// Serves the requests of the processes until all of them exit.
+static void serve() {
+    rendezvous_msg_t msg;
+    int fds[MIMPI_RENDEZVOUS_MAX_FDS];
+    struct signalfd_siginfo info;
+
+    while (g_active > 0 || g_running > 0) {
+        int ret = poll(g_sockets, g_n + 1, -1);
+        if (ret == -1 && errno == EINTR) continue;
+        ASSERT_SYS_OK(ret);
+
+        if (g_sockets[g_n].revents != 0) {
+            ASSERT_SYS_OK(read(g_sockets[g_n].fd, &info, sizeof(info)));
+            reap();
+        }
+
+        for (int k = 0; k < g_n; k++) {
+            if (g_sockets[k].fd == -1 || g_sockets[k].revents == 0) continue;
+
+            if (rendezvous_recv(g_sockets[k].fd, &msg, fds) == -1) {
+                finish(k);
+            } else if (msg.type == RENDEZVOUS_CONNECT) {
+                connect_pair(k, msg.peer);
+            } else if (msg.type == RENDEZVOUS_FINALIZE) {
+                rendezvous_send(g_sockets[k].fd, RENDEZVOUS_BYE, -1, NULL, 0);
+                finish(k);
+            }
+        }
+    }
+}
+
+/* Report */
+static double seconds(struct timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double metric(const rank_stats_t* stats, metric_t m) {
+    switch (m) {
+        case METRIC_WALL:
+            return (stats->end.tv_sec - stats->start.tv_sec) + (stats->end.tv_nsec - stats->start.tv_nsec) / 1e9;
+        case METRIC_USER: return seconds(stats->usage.ru_utime);
+        case METRIC_SYSTEM: return seconds(stats->usage.ru_stime);
+        case METRIC_MAX_RSS: return stats->usage.ru_maxrss;
+        case METRIC_VOLUNTARY: return stats->usage.ru_nvcsw;
+        case METRIC_INVOLUNTARY: return stats->usage.ru_nivcsw;
+        default: return 0;
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+// Puts the minimum, median and maximum of the metric across the processes in res.
+static void summarize(metric_t m, double* res) {
+    double values[MIMPI_MAX_N];
+    for (int k = 0; k < g_n; k++) {
+        values[k] = metric(&g_stats[k], m);
+    }
+    qsort(values, g_n, sizeof(double), compare_doubles);
+
+    res[0] = values[0];
+    res[1] = (values[(g_n - 1) / 2] + values[g_n / 2]) / 2;
+    res[2] = values[g_n - 1];
+}
+
+static void describe_status(char* buf, size_t size, int status) {
+    if (WIFEXITED(status)) snprintf(buf, size, "exit %d", WEXITSTATUS(status));
+    else if (WIFSIGNALED(status)) snprintf(buf, size, "signal %d", WTERMSIG(status));
+    else snprintf(buf, size, "unknown");
+}
+
+static void print_report() {
+    double res[3];
+    char status[32];
+
+    fprintf(stderr, "mimpirun: job summary of %d processes\n", g_n);
+    fprintf(stderr, "%-26s %12s %12s %12s\n", "metric", "min", "median", "max");
+    for (int m = 0; m < NUM_METRICS; m++) {
+        summarize(m, res);
+        fprintf(stderr, "%-26s %12.6g %12.6g %12.6g\n", g_metric_names[m], res[0], res[1], res[2]);
+    }
+
+    for (int k = 0; k < g_n; k++) {
+        if (WIFEXITED(g_stats[k].status) && WEXITSTATUS(g_stats[k].status) == 0) continue;
+        describe_status(status, sizeof(status), g_stats[k].status);
+        fprintf(stderr, "mimpirun: rank %d failed (%s)\n", k, status);
+    }
+}
+
+static void write_json_report(const char* path) {
+    double res[3];
+    char status[32];
+    FILE* file = fopen(path, "w");
+    if (file == NULL) syserr("Cannot open %s", path);
+
+    fprintf(file, "{\n  \"processes\": %d,\n  \"ranks\": [\n", g_n);
+    for (int k = 0; k < g_n; k++) {
+        describe_status(status, sizeof(status), g_stats[k].status);
+        fprintf(file, "    {\"rank\": %d, \"status\": \"%s\"", k, status);
+        for (int m = 0; m < NUM_METRICS; m++) {
+            fprintf(file, ", \"%s\": %.9g", g_metric_names[m], metric(&g_stats[k], m));
+        }
+        fprintf(file, "}%s\n", k + 1 < g_n ? "," : "");
+    }
+    fprintf(file, "  ],\n  \"summary\": {\n");
+    for (int m = 0; m < NUM_METRICS; m++) {
+        summarize(m, res);
+        fprintf(file, "    \"%s\": {\"min\": %.9g, \"median\": %.9g, \"max\": %.9g}%s\n",
+                g_metric_names[m], res[0], res[1], res[2], m + 1 < NUM_METRICS ? "," : "");
+    }
+    fprintf(file, "  }\n}\n");
+
+    if (fclose(file) != 0) syserr("Cannot write %s", path);
+}
+
+/* Binding */
+static int read_topology_id(int cpu, const char* name) {
+    char path[128];
+    int id = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return 0; // Missing topology means a single package and core per CPU.
+    if (fscanf(file, "%d", &id) != 1) id = 0;
+    fclose(file);
+    return id;
+}
+
+static int read_node(int cpu) {
+    char path[64];
+    int node = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+    DIR* dir = opendir(path);
+    if (dir == NULL) return 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && sscanf(entry->d_name + 4, "%d", &node) == 1) break;
+    }
+    closedir(dir);
+    return node;
+}
+
+static void read_topology() {
+    cpu_set_t allowed;
+    int core_keys[CPU_SETSIZE][2]; // (package, core id) of every core seen so far.
+    int num_cores = 0;
+
+    ASSERT_SYS_OK(sched_getaffinity(0, sizeof(allowed), &allowed));
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+
+        int i = g_num_cpus++;
+        g_cpus[i] = cpu;
+        g_package[i] = read_topology_id(cpu, "physical_package_id");
+        g_node[i] = read_node(cpu);
+
+        int core_id = read_topology_id(cpu, "core_id");
+        g_core[i] = 0;
+        while (g_core[i] < num_cores &&
+               (core_keys[g_core[i]][0] != g_package[i] || core_keys[g_core[i]][1] != core_id)) {
+            g_core[i]++;
+        }
+        if (g_core[i] == num_cores) {
+            core_keys[num_cores][0] = g_package[i];
+            core_keys[num_cores][1] = core_id;
+            num_cores++;
+        }
+    }
+}
+
+// Returns the number of distinct values among the first g_num_cpus in ids.
+static int count_distinct(const int* ids) {
+    int count = 0;
+    for (int i = 0; i < g_num_cpus; i++) {
+        bool seen = false;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = ids[j] == ids[i];
+        }
+        if (!seen) count++;
+    }
+    return count;
+}
+
+// Returns the id of the index-th distinct value in ids, in the order of CPUs.
+static int nth_distinct(const int* ids, int index) {
+    for (int i = 0; i < g_num_cpus; i++) {
+        bool seen = false;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = ids[j] == ids[i];
+        }
+        if (!seen && index-- == 0) return ids[i];
+    }
+    return -1;
+}
+
+// Puts the CPUs of process k in set. Returns false if the process is not to be bound.
+static bool compute_binding(int k, cpu_set_t* set) {
+    CPU_ZERO(set);
+
+    if (g_cpu_list_len > 0) {
+        CPU_SET(g_cpu_list[k % g_cpu_list_len], set);
+        return true;
+    }
+    if (g_bind == BIND_NONE) return false;
+
+    const int* ids = g_bind == BIND_CORE ? g_core : g_package;
+    int num = count_distinct(ids);
+    int per_unit = g_bind == BIND_CORE ? 1 : (g_n + num - 1) / num;
+    int id = nth_distinct(ids, (k / per_unit) % num);
+
+    for (int i = 0; i < g_num_cpus; i++) {
+        if (ids[i] == id) CPU_SET(g_cpus[i], set);
+    }
+    return true;
+}
+
+// NUMA nodes of the CPUs in set, or of all the CPUs if set is NULL.
+static unsigned long nodes_of(const cpu_set_t* set) {
+    unsigned long mask = 0;
+    for (int i = 0; i < g_num_cpus; i++) {
+        if ((set == NULL || CPU_ISSET(g_cpus[i], set)) && g_node[i] < MAX_NODES) mask |= 1UL << g_node[i];
+    }
+    return mask;
+}
+
+// Writes members of the set as a list of ranges like "0-3,8".
+static void format_list(char* buf, size_t size, const bool* members, int num) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < num && len < size; i++) {
+        if (!members[i]) continue;
+        int j = i;
+        while (j + 1 < num && members[j + 1]) j++;
+        len += snprintf(buf + len, size - len, len ? ",%d" : "%d", i);
+        // snprintf returns the length it would have written, so len may be past the end already.
+        if (j > i && len < size) len += snprintf(buf + len, size - len, "-%d", j);
+        i = j;
+    }
+}
+
+static const char* mem_policy_name(int policy) {
+    switch (policy) {
+        case MPOL_BIND: return "bind";
+        case MPOL_PREFERRED: return "preferred";
+        case MPOL_INTERLEAVE: return "interleave";
+        default: return "default";
+    }
+}
+
+// Called in process k before exec, both binding and memory policy survive it.
+static void apply_binding(int k) {
+    cpu_set_t set;
+    bool bound = compute_binding(k, &set);
+
+    if (bound) { ASSERT_SYS_OK(sched_setaffinity(0, sizeof(set), &set)); }
+
+    unsigned long nodes = nodes_of(bound ? &set : NULL);
+    if (g_mem_policy == MPOL_PREFERRED) nodes &= -nodes; // A single node is preferred.
+    if (g_mem_policy != MPOL_DEFAULT) {
+        ASSERT_SYS_OK(syscall(SYS_set_mempolicy, g_mem_policy, &nodes, MAX_NODES + 1));
+    }
+
+    if (!bound && g_mem_policy == MPOL_DEFAULT) return;
+
+    bool members[CPU_SETSIZE];
+    char cpus[256] = "any";
+    char node_list[256] = "any";
+    if (bound) {
+        for (int i = 0; i < CPU_SETSIZE; i++) members[i] = CPU_ISSET(i, &set);
+        format_list(cpus, sizeof(cpus), members, CPU_SETSIZE);
+    }
+    if (g_mem_policy != MPOL_DEFAULT) {
+        for (int i = 0; i < MAX_NODES; i++) members[i] = (nodes >> i) & 1;
+        format_list(node_list, sizeof(node_list), members, MAX_NODES);
+    }
+    fprintf(stderr, "mimpirun: rank %d bound to CPUs %s, memory policy %s on nodes %s\n",
+            k, cpus, mem_policy_name(g_mem_policy), node_list);
+}
+
+// Parses a list like "0,2,4-7" into g_cpu_list.
+static void parse_cpu_list(const char* str) {
+    char* end;
+    g_cpu_list_len = 0;
+
+    while (*str != '\0') {
+        long first = strtol(str, &end, 10);
+        long last = first;
+        if (end == str) fatal("Invalid CPU list at: %s", str);
+        if (*end == '-') {
+            str = end + 1;
+            last = strtol(str, &end, 10);
+            if (end == str) fatal("Invalid CPU list at: %s", str);
+        }
+        if (first < 0 || last >= CPU_SETSIZE || first > last) fatal("Invalid CPU range %ld-%ld", first, last);
+
+        for (long cpu = first; cpu <= last && g_cpu_list_len < CPU_SETSIZE; cpu++) {
+            g_cpu_list[g_cpu_list_len++] = (int) cpu;
+        }
+
+        if (*end == ',') end++;
+        else if (*end != '\0') fatal("Invalid CPU list at: %s", end);
+        str = end;
+    }
+}
+
+static void parse_options(int argc, char** argv) {
+    static const struct option options[] = {
+        {"bind-to", required_argument, NULL, 'b'},
+        {"cpu-list", required_argument, NULL, 'c'},
+        {"mem-policy", required_argument, NULL, 'm'},
+        {"report", no_argument, NULL, 'r'},
+        {"report-json", required_argument, NULL, 'j'},
+        {"stripes", required_argument, NULL, 's'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+
+    // Options end at the number of processes, so that the program keeps its own.
+    while ((opt = getopt_long(argc, argv, "+", options, NULL)) != -1) {
+        switch (opt) {
+            case 'b':
+                if (strcmp(optarg, "core") == 0) g_bind = BIND_CORE;
+                else if (strcmp(optarg, "socket") == 0) g_bind = BIND_SOCKET;
+                else if (strcmp(optarg, "none") == 0) g_bind = BIND_NONE;
+                else fatal("Invalid --bind-to %s (core, socket or none expected)", optarg);
+                break;
+            case 'c':
+                parse_cpu_list(optarg);
+                break;
+            case 'm':
+                if (strcmp(optarg, "bind") == 0) g_mem_policy = MPOL_BIND;
+                else if (strcmp(optarg, "preferred") == 0) g_mem_policy = MPOL_PREFERRED;
+                else if (strcmp(optarg, "interleave") == 0) g_mem_policy = MPOL_INTERLEAVE;
+                else if (strcmp(optarg, "default") == 0) g_mem_policy = MPOL_DEFAULT;
+                else fatal("Invalid --mem-policy %s (bind, preferred, interleave or default expected)", optarg);
+                break;
+            case 'r':
+                g_report = true;
+                break;
+            case 'j':
+                g_report_json = optarg;
+                break;
+            case 's':
+                g_stripes = atoi(optarg);
+                if (g_stripes < 1 || g_stripes > MIMPI_MAX_STRIPES) {
+                    fatal("Invalid --stripes %s (1 to %d expected)", optarg, MIMPI_MAX_STRIPES);
+                }
+                break;
+            default:
+                fatal("Usage: %s [--bind-to core|socket|none] [--cpu-list list] "
+                      "[--mem-policy bind|preferred|interleave|default] [--report] [--report-json path] "
+                      "[--stripes k] "
+                      "number_of_processes program_name [...]", argv[0]);
+        }
+    }
 }
 
 int main(int argc, char** argv) {
+    parse_options(argc, argv);
+    argc -= optind - 1;
+    argv += optind - 1;
+
     if (argc < 3) {
         fatal("Usage: %s program_name number_of_processes [...]\n", argv[0]);
     }
@@ -47,28 +535,45 @@ int main(int argc, char** argv) {
 
     char** args = &argv[2];
 
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            if (i != j) {
-                open_channel(MIMPI_READ_OFFSET + MIMPI_MAX_N * i + j,
-                             MIMPI_WRITE_OFFSET + MIMPI_MAX_N * i + j);
-            }
+    g_n = n;
+    g_active = n;
+    g_running = n;
+    read_topology();
+    for (int i = 0; i < g_cpu_list_len; i++) {
+        bool allowed = false;
+        for (int j = 0; j < g_num_cpus && !allowed; j++) {
+            allowed = g_cpus[j] == g_cpu_list[i];
         }
+        if (!allowed) fatal("CPU %d is not available", g_cpu_list[i]);
     }
+    // SIGCHLD is taken through a descriptor, so that exits are noticed while serving the processes.
+    sigset_t sigchld;
+    sigset_t old_mask;
+    sigemptyset(&sigchld);
+    sigaddset(&sigchld, SIGCHLD);
+    ASSERT_SYS_OK(sigprocmask(SIG_BLOCK, &sigchld, &old_mask));
+    g_sockets[n].fd = signalfd(-1, &sigchld, SFD_CLOEXEC);
+    ASSERT_SYS_OK(g_sockets[n].fd);
+    g_sockets[n].events = POLLIN;
 
     for (int k = 0; k < n; k++) {
+        int rendezvous[2];
+        ASSERT_SYS_OK(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, rendezvous));
+
+        ASSERT_SYS_OK(clock_gettime(CLOCK_MONOTONIC, &g_stats[k].start));
         pid_t pid = fork();
         ASSERT_SYS_OK(pid);
 
         if (!pid) {
 
-            for (int i = 0; i < n; i++) {
-                for (int j = 0; j < n; j++) {
-                    if (i != j) {
-                        if (j != k) { ASSERT_SYS_OK(close(MIMPI_READ_OFFSET + MIMPI_MAX_N * i + j)); }
-                        if (i != k) { ASSERT_SYS_OK(close(MIMPI_WRITE_OFFSET + MIMPI_MAX_N * i + j)); }
-                    }
-                }
+            for (int i = 0; i < k; i++) {
+                ASSERT_SYS_OK(close(g_sockets[i].fd));
+            }
+            ASSERT_SYS_OK(close(rendezvous[0]));
+
+            if (rendezvous[1] != MIMPI_RENDEZVOUS_FD) {
+                ASSERT_SYS_OK(dup2(rendezvous[1], MIMPI_RENDEZVOUS_FD));
+                ASSERT_SYS_OK(close(rendezvous[1]));
             }
 
             // Add additional info to environment.
@@ -87,21 +592,34 @@ int main(int argc, char** argv) {
             ASSERT_SYS_OK(setenv("MIMPI_rank", k_str, true));
             ASSERT_SYS_OK(setenv("MIMPI_size", n_str, true));
 
+            char stripes_str[4];
+            ret = snprintf(stripes_str, sizeof(stripes_str), "%d", g_stripes);
+            if (ret < 0 || ret >= (int) sizeof(stripes_str)) {
+                fatal("Error in snprintf.");
+            }
+            ASSERT_SYS_OK(setenv("MIMPI_stripes", stripes_str, true));
+
+            apply_binding(k);
+            ASSERT_SYS_OK(sigprocmask(SIG_SETMASK, &old_mask, NULL));
+
             ASSERT_SYS_OK(execvp(prog, args));
         }
-    }
 
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            if (i != j) {
-                ASSERT_SYS_OK(close(MIMPI_READ_OFFSET + MIMPI_MAX_N * i + j));
-                ASSERT_SYS_OK(close(MIMPI_WRITE_OFFSET + MIMPI_MAX_N * i + j));
-            }
-        }
+        ASSERT_SYS_OK(close(rendezvous[1]));
+        g_stats[k].pid = pid;
+        g_sockets[k].fd = rendezvous[0];
+        g_sockets[k].events = POLLIN;
     }
 
-    for (int i = 0; i < n; i++) {
-        ASSERT_SYS_OK(wait(NULL));
+    serve();
+    ASSERT_SYS_OK(close(g_sockets[n].fd));
+
+    if (g_report) print_report();
+    if (g_report_json) write_json_report(g_report_json);
+
+    // Fails if any process has, so that scripts can tell.
+    for (int k = 0; k < n; k++) {
+        if (!WIFEXITED(g_stats[k].status) || WEXITSTATUS(g_stats[k].status) != 0) return 1;
     }
     return 0;
 }
\ No newline at end of file
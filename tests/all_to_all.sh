@@ -0,0 +1,7 @@
+set -ex
+for n in 1 2 5 8 13
+do
+    MIMPI_TUNING="allgather * * bruck;alltoall * * bruck" timeout 1s ./mimpirun $n examples_build/all_to_all
+    MIMPI_TUNING="allgather * * ring;alltoall * * pairwise" timeout 1s ./mimpirun $n examples_build/all_to_all
+done
+timeout 1s ./mimpirun 16 examples_build/all_to_all 5000
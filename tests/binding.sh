@@ -0,0 +1,13 @@
+set -ex
+bindings=`mktemp`
+for binding in "--bind-to core" "--bind-to socket" "--cpu-list 0" "--bind-to core --mem-policy bind" "--mem-policy interleave"
+do
+    timeout 1s ./mimpirun $binding 4 examples_build/broadcast > /dev/null 2> "$bindings"
+    test `grep -c "^mimpirun: rank [0-3] bound to CPUs" "$bindings"` -eq 4
+done
+timeout 1s ./mimpirun --cpu-list 0 2 /bin/grep Cpus_allowed_list /proc/self/status | grep -c "0$" | grep -q 2
+timeout 1s ./mimpirun --bind-to none 3 examples_build/broadcast > /dev/null 2> "$bindings"
+test ! -s "$bindings"
+rm "$bindings"
+(! ./mimpirun --bind-to nothing 2 examples_build/hello)
+(! ./mimpirun --cpu-list 100000 2 examples_build/hello)
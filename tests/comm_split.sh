@@ -0,0 +1,3 @@
+set -ex
+timeout 1s ./mimpirun 5 examples_build/comm_split
+timeout 1s ./mimpirun 16 examples_build/comm_split
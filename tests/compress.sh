@@ -0,0 +1,7 @@
+set -ex
+test "$(env -u MIMPI_COMPRESS timeout 5s ./mimpirun 2 examples_build/compress)" = "ratio 1.0"
+ratio=$(MIMPI_COMPRESS=1024 timeout 5s ./mimpirun 2 examples_build/compress | sed -n 's/^ratio //p')
+awk -v r="$ratio" 'BEGIN { exit !(r > 5) }'
+MIMPI_COMPRESS=1024 timeout 5s ./mimpirun 5 examples_build/compress
+MIMPI_COMPRESS=1 timeout 5s ./mimpirun 4 examples_build/sendrecv
+MIMPI_COMPRESS=1 timeout 5s ./mimpirun 4 examples_build/nonblocking
@@ -0,0 +1,12 @@
+set -ex
+
+# A short message overtakes a big one sent before it on a slow channel.
+# The big one is left uncompressed, as it would take no time otherwise.
+config=`mktemp`
+echo "* * bandwidth=8000000" > "$config"
+out=`env -u MIMPI_COMPRESS MIMPI_NET_CONFIG="$config" timeout 5s ./mimpirun 2 examples_build/control_lane`
+rm "$config"
+note=`echo "$out" | sed -n 's/^note_ms \([0-9]*\) .*/\1/p'`
+data=`echo "$out" | sed -n 's/.* data_ms \([0-9]*\)$/\1/p'`
+test "$data" -ge 400
+test "$note" -lt 300
@@ -1,2 +1,10 @@
 set -ex
-timeout 1s ./mimpirun 4 examples_build/deadlock
+# WAITINGs of both deadlocks may arrive together, or with the end of the partner, which happens in some runs only.
+for spin in 0 2000
+do
+    for i in {1..12}
+    do
+        out=`MIMPI_SPIN=$spin timeout 2s ./mimpirun 4 examples_build/deadlock 2>&1`
+        echo "$out" | grep -c "Assertion" | grep -qx 0
+    done
+done
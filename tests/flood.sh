@@ -0,0 +1,4 @@
+set -ex
+timeout 10s ./mimpirun 2 examples_build/flood | grep -c Done | grep -qx 2
+timeout 10s ./mimpirun 4 examples_build/flood | grep -c Done | grep -qx 4
+MIMPI_SPIN=0 timeout 10s ./mimpirun 4 examples_build/flood | grep -c Done | grep -qx 4
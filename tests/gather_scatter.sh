@@ -0,0 +1,9 @@
+set -ex
+for n in 1 2 6 13 16
+do
+    timeout 1s ./mimpirun $n examples_build/gather_scatter
+    MIMPI_TUNING="gather * * linear;scatter * * linear" timeout 1s ./mimpirun $n examples_build/gather_scatter
+    # Blocks of the variable-count collectives differ in size, which must not change the algorithm.
+    MIMPI_TUNING="gather * 3 linear;gather * * binomial;scatter * 3 linear;scatter * * binomial" \
+        timeout 1s ./mimpirun $n examples_build/gather_scatter
+done
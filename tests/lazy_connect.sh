@@ -0,0 +1,10 @@
+set -ex
+# Rings of io_uring and the reduction pool come with descriptors and threads of their own.
+unset MIMPI_URING MIMPI_REDUCTION_THREADS
+timeout 1s ./mimpirun 1 examples_build/lazy_connect | grep -c Done | grep -qx 1
+timeout 1s ./mimpirun 2 examples_build/lazy_connect | grep -c Done | grep -qx 2
+for i in {1..5}
+do
+    timeout 2s ./mimpirun 16 examples_build/lazy_connect | grep -c Done | grep -qx 16
+done
+timeout 1s ./mimpirun --stripes 3 2 examples_build/lazy_connect 3 | grep -c Done | grep -qx 2
@@ -0,0 +1,5 @@
+set -ex
+timeout 1s ./mimpirun 1 examples_build/neighbor
+timeout 1s ./mimpirun 3 examples_build/neighbor
+timeout 2s ./mimpirun 8 examples_build/neighbor
+timeout 2s ./mimpirun 16 examples_build/neighbor
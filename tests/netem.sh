@@ -0,0 +1,26 @@
+set -ex
+ms() { echo $(( $(date +%s%N) / 1000000 )); }
+
+# Reads from different processes are delayed at the same time, not one after another.
+MIMPI_READ_DELAY=10 timeout 0.4s ./mimpirun 8 examples_build/fan_in | grep -q "from 7"
+
+# Overrides apply only to the channel they name, here the one used by the ring or the opposite one.
+config=`mktemp`
+echo "0 1 latency_us=500000" > "$config"
+start=`ms`
+MIMPI_NET_CONFIG="$config" timeout 5s ./mimpirun 3 examples_build/sendrecv
+test $(( `ms` - start )) -ge 500
+echo "1 0 latency_us=500000" > "$config"
+start=`ms`
+MIMPI_NET_CONFIG="$config" timeout 5s ./mimpirun 3 examples_build/sendrecv
+test $(( `ms` - start )) -lt 400
+
+# Compression would make the data too small to take long.
+echo "* * bandwidth=10000000 jitter_us=1000" > "$config"
+start=`ms`
+env -u MIMPI_COMPRESS MIMPI_NET_CONFIG="$config" MIMPI_NET_SEED=7 timeout 5s ./mimpirun 3 examples_build/sendrecv
+test $(( `ms` - start )) -ge 400
+
+echo "0 1 speed=fast" > "$config"
+MIMPI_NET_CONFIG="$config" timeout 1s ./mimpirun 2 examples_build/sendrecv 2>&1 | grep -q "Unknown setting"
+rm "$config"
@@ -0,0 +1,11 @@
+set -ex
+for algorithm in binary binomial binomial_pipelined chain
+do
+    MIMPI_TUNING="bcast * * $algorithm;reduce * * $algorithm" timeout 2s ./mimpirun 1 examples_build/nonblocking
+    MIMPI_TUNING="bcast * * $algorithm;reduce * * $algorithm" timeout 2s ./mimpirun 5 examples_build/nonblocking
+    MIMPI_TUNING="bcast * * $algorithm;reduce * * $algorithm" timeout 2s ./mimpirun 16 examples_build/nonblocking
+done
+for algorithm in binary binomial dissemination
+do
+    MIMPI_TUNING="barrier * * $algorithm" timeout 2s ./mimpirun 7 examples_build/nonblocking
+done
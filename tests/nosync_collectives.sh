@@ -0,0 +1,6 @@
+set -ex
+for algorithm in binary binomial binomial_pipelined chain
+do
+    MIMPI_TUNING="bcast * * $algorithm;reduce * * $algorithm" timeout 1s ./mimpirun 2 examples_build/nosync_collectives
+    MIMPI_TUNING="bcast * * $algorithm;reduce * * $algorithm" timeout 1s ./mimpirun 11 examples_build/nosync_collectives
+done
@@ -0,0 +1,7 @@
+set -ex
+MIMPI_REDUCTION_THREADS=3 MIMPI_TUNING="reduce * * binomial" timeout 2s ./mimpirun 5 examples_build/bare_reduce 1000000 | grep -x "Number: 5"
+MIMPI_REDUCTION_THREADS=3 timeout 1s ./mimpirun 3 examples_build/reduction
+
+# With the default tuning the reduction is pipelined, and its segments still go to the pool.
+MIMPI_REDUCTION_THREADS=3 timeout 5s ./mimpirun 3 examples_build/reduction_pool | grep -q "^pooled [1-9]"
+env -u MIMPI_REDUCTION_THREADS timeout 5s ./mimpirun 3 examples_build/reduction_pool | grep -qx "pooled 0"
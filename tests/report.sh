@@ -0,0 +1,16 @@
+set -ex
+report=`mktemp`
+timeout 1s ./mimpirun --report --report-json "$report" 5 examples_build/broadcast > /dev/null 2> "$report.txt"
+for metric in wall_time_s user_cpu_s system_cpu_s max_rss_kib voluntary_ctx_switches involuntary_ctx_switches
+do
+    grep -q "^$metric " "$report.txt"
+    grep -q "\"$metric\": {\"min\"" "$report"
+done
+test `grep -c '"status": "exit 0"' "$report"` -eq 5
+status=0
+timeout 1s ./mimpirun --report 2 /bin/false 2> "$report.txt" || status=$?
+test $status -eq 1
+test `grep -c "failed (exit 1)" "$report.txt"` -eq 2
+# A process killed by a signal fails the run as well.
+(! timeout 1s ./mimpirun 2 sh -c 'test $MIMPI_rank -eq 0 || kill -KILL $$')
+rm "$report" "$report.txt"
@@ -0,0 +1,7 @@
+set -ex
+timeout 2s ./mimpirun 1 examples_build/rma
+timeout 2s ./mimpirun 4 examples_build/rma
+timeout 5s ./mimpirun 16 examples_build/rma
+
+# The shared memory of windows is gone once they have been created.
+! ls /dev/shm | grep -q "^mimpi-"
@@ -0,0 +1,7 @@
+set -ex
+csv=`mktemp`
+timeout 20s ./scaling -n "3 5" -w "1 300" -d "10" -c "barrier bcast reduce scan" -o "$csv" > /dev/null
+test `wc -l < "$csv"` -eq 15
+test `grep -c ",optimal$\|,ok$" "$csv"` -eq 10
+grep -q "^scan,5,300,10,[0-9.]*,,,n/a$" "$csv"
+rm "$csv"
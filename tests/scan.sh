@@ -0,0 +1,5 @@
+set -ex
+for n in 1 2 3 8 13 16
+do
+    timeout 1s ./mimpirun $n examples_build/scan
+done
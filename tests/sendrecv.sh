@@ -0,0 +1,3 @@
+set -ex
+timeout 2s ./mimpirun 2 examples_build/sendrecv
+timeout 2s ./mimpirun 5 examples_build/sendrecv
@@ -0,0 +1,8 @@
+set -ex
+for spin in 0 1 2000
+do
+    MIMPI_SPIN=$spin timeout 1s ./mimpirun 4 examples_build/deadlock
+    MIMPI_SPIN=$spin timeout 2s ./mimpirun 5 examples_build/sendrecv
+    MIMPI_SPIN=$spin timeout 2s ./mimpirun 3 examples_build/pipe_closed
+    MIMPI_SPIN=$spin timeout 2s ./mimpirun 5 examples_build/nonblocking
+done
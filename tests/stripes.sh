@@ -0,0 +1,22 @@
+set -ex
+ms() { echo $(( $(date +%s%N) / 1000000 )); }
+
+for k in 1 2 3 4
+do
+    timeout 5s ./mimpirun --stripes $k 2 examples_build/stripes | grep -c Done | grep -qx 2
+    timeout 5s ./mimpirun --stripes $k 3 examples_build/stripes | grep -c Done | grep -qx 3
+done
+MIMPI_COMPRESS=1 timeout 5s ./mimpirun --stripes 3 3 examples_build/stripes | grep -c Done | grep -qx 3
+timeout 1s ./mimpirun --stripes 5 2 examples_build/stripes 2>&1 | grep -q "Invalid --stripes"
+
+# Every stripe is a link of its own, so four of them carry the data in a quarter of the time.
+# Compression would make the data too small to take long.
+config=`mktemp`
+echo "* * bandwidth=8000000" > "$config"
+start=`ms`
+env -u MIMPI_COMPRESS MIMPI_NET_CONFIG="$config" timeout 5s ./mimpirun 2 examples_build/stripes
+test $(( `ms` - start )) -ge 700
+start=`ms`
+env -u MIMPI_COMPRESS MIMPI_NET_CONFIG="$config" timeout 5s ./mimpirun --stripes 4 2 examples_build/stripes
+test $(( `ms` - start )) -lt 600
+rm "$config"
@@ -0,0 +1,10 @@
+set -ex
+for algorithm in binary binomial binomial_pipelined chain
+do
+    MIMPI_TUNING="bcast * * $algorithm;reduce * * $algorithm" timeout 1s ./mimpirun 7 examples_build/reduction
+    MIMPI_TUNING="bcast * * $algorithm" timeout 1s ./mimpirun 7 examples_build/broadcast > /dev/null
+done
+for algorithm in binary binomial dissemination
+do
+    MIMPI_TUNING="barrier * * $algorithm" timeout 1s ./mimpirun 7 examples_build/barrier > /dev/null
+done
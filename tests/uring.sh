@@ -0,0 +1,15 @@
+set -ex
+
+# The tests of point-to-point messages, collectives, failures and the emulated network again,
+# with writes through io_uring.
+export MIMPI_URING=1
+for t in sendrecv big_message pipe_closed deadlock flood nonblocking gather_scatter reduction all_to_all comm_split \
+         netem control_lane stripes
+do
+    bash tests/$t.sh
+done
+for self in barrier broadcast send_recv
+do
+    cmd=`head -n1 tests/$self.self`
+    diff <(echo "$cmd"; echo "====================================================================="; bash -c "$cmd") tests/$self.self
+done
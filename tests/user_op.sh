@@ -0,0 +1,7 @@
+set -ex
+for algorithm in binary binomial binomial_pipelined chain
+do
+    MIMPI_TUNING="reduce * * $algorithm" timeout 2s ./mimpirun 1 examples_build/user_op
+    MIMPI_TUNING="reduce * * $algorithm" timeout 2s ./mimpirun 6 examples_build/user_op
+    MIMPI_TUNING="reduce * * $algorithm" timeout 2s ./mimpirun 13 examples_build/user_op
+done